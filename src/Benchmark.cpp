@@ -0,0 +1,647 @@
+﻿#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include <glm/ext/matrix_clip_space.hpp>
+
+#include "BoundingVolumeHierarchy.h"
+#include "Camera.h"
+#include "CubeGen.h"
+#include "Headless.h"
+#include "Light.h"
+#include "Mesh.h"
+#include "OutlineShader.h"
+#include "RainbowShader.h"
+#include "Renderer.h"
+#include "ShadowMap.h"
+#include "SimpleShader.h"
+#include "Texture.h"
+#include "TexturedShader.h"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double secondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	/**
+	 * \brief An unlit shader counting the fragments it shades. Not thread safe, only used by single threaded renderers
+	 */
+	class CountingShader : public SimpleShader
+	{
+	public:
+		explicit CountingShader(glm::mat4 persp) : SimpleShader{ persp, false } {}
+
+		ofColor runFragmentShader(const glm::vec3& barycentric, const TriangleContext& triangle) override
+		{
+			fragments++;
+			return SimpleShader::runFragmentShader(barycentric, triangle);
+		}
+
+		void runFragmentBatch(const FragmentBatch& batch, const TriangleContext& triangle, SimdLevel simd,
+		                      ofColor* colors) override
+		{
+			fragments += countBits(batch.lanes);
+			SimpleShader::runFragmentBatch(batch, triangle, simd, colors);
+		}
+
+		uint64_t fragments{ 0 };
+	};
+
+	/**
+	 * \brief Meshes from CubeGen scattered in front of the camera, plus the lights shading them
+	 */
+	struct BenchmarkScene
+	{
+		std::vector<Mesh> meshes;
+		// Lights keep a reference to their mesh, lightMeshes must never reallocate
+		std::vector<Mesh> lightMeshes;
+		std::vector<Light> lights;
+
+		size_t triangleCount() const
+		{
+			size_t count = 0;
+			for (const Mesh& mesh : meshes)
+				count += mesh.getTriangleCount();
+			return count;
+		}
+
+		size_t vertexCount() const
+		{
+			size_t count = 0;
+			for (const Mesh& mesh : meshes)
+				count += mesh.getVertexCount();
+			return count;
+		}
+	};
+
+	/**
+	 * \brief Generates the same scene for the same arguments
+	 * \param meshCount the number of cubes, pyramids and octahedra
+	 * \param scale the average size of the meshes
+	 * \param lightCount the number of lights
+	 * \param seed the seed of the random generator placing the meshes
+	 */
+	void generateScene(BenchmarkScene& scene, int meshCount, float scale, int lightCount, unsigned seed)
+	{
+		std::mt19937 random{ seed };
+		std::uniform_real_distribution<float> unit{ 0, 1 };
+		const auto range = [&](float min, float max) { return min + (max - min) * unit(random); };
+
+		scene.meshes.reserve(meshCount);
+		for (int i = 0; i < meshCount; i++)
+		{
+			const glm::vec3 position{ range(-4, 4), range(-3, 3), range(-2, 2) };
+			const glm::vec3 size{ scale * range(0.5f, 1.5f) };
+			const ofColor color(random() % 256, random() % 256, random() % 256);
+
+			switch (i % 3)
+			{
+			case 0:
+				scene.meshes.push_back(generateCube(position, size, color));
+				break;
+			case 1:
+				scene.meshes.push_back(generatePyramid(position, size, color));
+				break;
+			default:
+				scene.meshes.push_back(generateOctahed(position, size, color));
+				break;
+			}
+
+			scene.meshes.back().setRotation({ range(0, 360), range(0, 360), range(0, 360) });
+		}
+
+		scene.lightMeshes.reserve(lightCount);
+		scene.lights.reserve(lightCount);
+		for (int i = 0; i < lightCount; i++)
+		{
+			const ofColor color(random() % 256, random() % 256, random() % 256);
+			scene.lightMeshes.push_back(generateCube({ range(-4, 4), range(-3, 3), range(-3, 3) }, glm::vec3{ 0.1f }, color));
+			scene.lights.emplace_back(scene.lightMeshes.back(), range(0.5f, 2), color);
+		}
+	}
+
+	glm::mat4 getPerspective(int width, int height)
+	{
+		return glm::perspective(glm::radians(90.0f), static_cast<float>(width) / height, 0.1f, 100.0f);
+	}
+
+	// The camera looks at the scenes from far enough to see most of them
+	glm::mat4 getView()
+	{
+		Camera cam{ { 0, 0, -7 } };
+		return cam.getMatrix();
+	}
+
+	/**
+	 * \brief Draws a scene with a single thread and counts what goes through the pipeline
+	 */
+	void benchmarkRasterizer(const char* name, int meshCount, float scale, int frames)
+	{
+		constexpr int width = 1280, height = 720;
+
+		BenchmarkScene scene;
+		generateScene(scene, meshCount, scale, 0, 1234);
+
+		Renderer renderer{ width, height, 1 };
+		renderer.setCullMode(CullMode::Back);
+
+		CountingShader shader{ getPerspective(width, height) };
+		shader.setUniform4fm("view", getView());
+
+		const auto start = Clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			renderer.clearBuffers();
+			for (Mesh& mesh : scene.meshes)
+				mesh.render(renderer, shader);
+		}
+		const double seconds = secondsSince(start);
+
+		const double triangles = static_cast<double>(scene.triangleCount()) * frames;
+		const double vertices = static_cast<double>(scene.vertexCount()) * frames;
+		const double fragments = static_cast<double>(shader.fragments);
+
+		std::printf("%-28s %10.2f Mtri/s %10.2f Mvert/s %10.2f Mfrag/s %8.2f ns/frag %8.3f ms/frame\n", name,
+		            triangles / seconds / 1e6, vertices / seconds / 1e6, fragments / seconds / 1e6,
+		            fragments > 0 ? seconds / fragments * 1e9 : 0.0, seconds / frames * 1000);
+	}
+
+	/**
+	 * \brief What the fragment shader benchmarks shade: a triangle, and barycentric coordinates spread over it
+	 */
+	struct ShaderInput
+	{
+		TriangleContext triangle;
+		std::vector<glm::vec3> barycentric;
+	};
+
+	ShaderInput makeShaderInput()
+	{
+		ShaderInput input;
+		TriangleContext& triangle = input.triangle;
+		// A triangle facing the lights, with different data on each vertex
+		const glm::vec3 corners[] = { { 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 } };
+		for (int i = 0; i < 3; i++)
+		{
+			triangle.normals[i] = glm::normalize(glm::vec3{ corners[i].y, corners[i].x, -1 });
+			triangle.colors[i] = ofColor(80 * i, 200, 255 - 60 * i);
+			triangle.localPos[i] = corners[i] - glm::vec3{ 0.5f };
+			triangle.globalPos[i] = glm::vec4{ triangle.localPos[i], 1 };
+			// The texture repeated four times over the triangle
+			triangle.uvs[i] = glm::vec2{ corners[i].x, corners[i].y } * 4.0f;
+		}
+		// Small enough on screen for a 256x256 texture to be read between its second and third mipmap levels
+		triangle.uvLod = Texture::getTriangleLod(triangle.uvs, 65536);
+
+		// A fixed set of barycentric coordinates spread over the triangle
+		std::mt19937 random{ 42 };
+		std::uniform_real_distribution<float> unit{ 0, 1 };
+		input.barycentric.resize(1024);
+		for (auto& coords : input.barycentric)
+		{
+			float u = unit(random), v = unit(random);
+			if (u + v > 1)
+			{
+				u = 1 - u;
+				v = 1 - v;
+			}
+			coords = { u, v, 1 - u - v };
+		}
+		return input;
+	}
+
+	/**
+	 * \brief Runs a fragment shader on the same triangle over and over, without rasterizing anything
+	 */
+	template <class ShaderT>
+	void benchmarkShader(const char* name, ShaderT& shader, int fragments)
+	{
+		const ShaderInput input = makeShaderInput();
+		const TriangleContext& triangle = input.triangle;
+		const std::vector<glm::vec3>& barycentric = input.barycentric;
+
+		// The colors are summed, so that the compiler can't skip the calls
+		unsigned checksum = 0;
+		const auto start = Clock::now();
+		for (int i = 0; i < fragments; i++)
+		{
+			const ofColor col = ShaderDispatch<ShaderT>::runFragmentShader(shader, barycentric[i % barycentric.size()],
+			                                                               triangle);
+			checksum += col.r + col.g + col.b;
+		}
+		const double seconds = secondsSince(start);
+
+		std::printf("%-28s %8.2f ns/frag %10.2f Mfrag/s  (checksum %u)\n", name, seconds / fragments * 1e9,
+		            fragments / seconds / 1e6, checksum);
+	}
+
+	/**
+	 * \brief The same, shading full batches of fragments like the rasterizer does, with the given instruction set. The
+	 * checksum matches the one of benchmarkShader() whichever it is
+	 */
+	template <class ShaderT>
+	void benchmarkShaderBatches(const char* name, ShaderT& shader, int fragments, SimdLevel simd)
+	{
+		const ShaderInput input = makeShaderInput();
+		constexpr int BATCH_SIZE = FragmentBatch::MAX_SIZE;
+
+		// The barycentric coordinates in batches, the last one wrapping around to the first coordinates
+		const size_t batchCount = (input.barycentric.size() + BATCH_SIZE - 1) / BATCH_SIZE;
+		std::vector<FragmentBatch> batches(batchCount);
+		for (size_t i = 0; i < batchCount * BATCH_SIZE; i++)
+		{
+			const glm::vec3& coords = input.barycentric[i % input.barycentric.size()];
+			for (int j = 0; j < 3; j++)
+				batches[i / BATCH_SIZE].barycentric[j][i % BATCH_SIZE] = coords[j];
+		}
+		for (FragmentBatch& batch : batches)
+			batch.lanes = (1u << BATCH_SIZE) - 1;
+
+		unsigned checksum = 0;
+		ofColor colors[BATCH_SIZE];
+		const auto start = Clock::now();
+		for (int i = 0; i < fragments; i += BATCH_SIZE)
+		{
+			ShaderDispatch<ShaderT>::runFragmentBatch(shader, batches[i / BATCH_SIZE % batchCount], input.triangle, simd,
+			                                          colors);
+			for (const ofColor& col : colors)
+				checksum += col.r + col.g + col.b;
+		}
+		const double seconds = secondsSince(start);
+
+		std::printf("%-28s %8.2f ns/frag %10.2f Mfrag/s  (checksum %u)\n", name, seconds / fragments * 1e9,
+		            fragments / seconds / 1e6, checksum);
+	}
+
+	/**
+	 * \brief Draws a scene with a single thread, once with an unlit shader and once only its depth, like a shadow map
+	 * pass does
+	 */
+	void benchmarkDepthPass(const char* name, int meshCount, float scale, int frames)
+	{
+		constexpr int width = 1280, height = 720;
+
+		BenchmarkScene scene;
+		generateScene(scene, meshCount, scale, 0, 1234);
+
+		Renderer renderer{ width, height, 1 };
+		renderer.setCullMode(CullMode::Back);
+
+		const glm::mat4 persp = getPerspective(width, height);
+		SimpleShader shader{ persp, false };
+		shader.setUniform4fm("view", getView());
+		const glm::mat4 viewProjection = persp * getView();
+
+		auto start = Clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			renderer.clearBuffers();
+			for (Mesh& mesh : scene.meshes)
+				mesh.render(renderer, shader);
+		}
+		const double color = secondsSince(start) / frames;
+
+		start = Clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			renderer.clearDepth();
+			for (Mesh& mesh : scene.meshes)
+				mesh.renderDepth(renderer, viewProjection);
+		}
+		const double depth = secondsSince(start) / frames;
+
+		std::printf("%-28s %8.3f ms/frame unlit %8.3f ms/frame depth only %6.2fx\n", name, color * 1000, depth * 1000,
+		            color / depth);
+	}
+
+	/**
+	 * \brief Renders the six faces of the shadow map of a light in the middle of a scene
+	 */
+	void benchmarkShadowMap(int size, int frames, unsigned threads)
+	{
+		BenchmarkScene scene;
+		generateScene(scene, 300, 0.6f, 0, 5678);
+		std::vector<Mesh*> casters;
+		for (Mesh& mesh : scene.meshes)
+			casters.push_back(&mesh);
+
+		Renderer renderer{ size, size, threads };
+		renderer.setCullMode(CullMode::Back);
+		ShadowMap map{ size };
+
+		const auto start = Clock::now();
+		for (int frame = 0; frame < frames; frame++)
+			map.render(renderer, { 0, 0, 0 }, casters);
+		const double seconds = secondsSince(start) / frames;
+
+		const std::string name = "shadow map, 6x" + std::to_string(size) + "x" + std::to_string(size);
+		std::printf("%-28s %8.3f ms/map\n", name.c_str(), seconds * 1000);
+	}
+
+	/**
+	 * \brief Draws the same cubes as separate meshes, each with its own copy of the vertices, then as the instances of a
+	 * single shared cube
+	 */
+	void benchmarkInstancing(int cubeCount, int frames, unsigned threads)
+	{
+		constexpr int width = 1280, height = 720;
+
+		std::mt19937 random{ 1516 };
+		std::uniform_real_distribution<float> unit{ 0, 1 };
+		const auto range = [&](float min, float max) { return min + (max - min) * unit(random); };
+
+		std::vector<Mesh> meshes;
+		std::vector<InstanceUniforms> instances;
+		meshes.reserve(cubeCount);
+		instances.reserve(cubeCount);
+		for (int i = 0; i < cubeCount; i++)
+		{
+			const ofColor color(random() % 256, random() % 256, random() % 256);
+			meshes.push_back(generateCube({ range(-4, 4), range(-3, 3), range(-2, 2) }, glm::vec3{ range(0.02f, 0.06f) },
+			                              color));
+			meshes.back().setRotation({ range(0, 360), range(0, 360), range(0, 360) });
+			instances.push_back(InstanceUniforms::fromTransform(meshes.back().getMatrix(), color));
+		}
+		// White, the instances give it their color
+		Mesh cube = generateCube({}, glm::vec3{ 1 }, { 255, 255 });
+
+		Renderer renderer{ width, height, threads };
+		renderer.setCullMode(CullMode::Back);
+
+		SimpleShader shader{ getPerspective(width, height), false };
+		shader.setUniform4fm("view", getView());
+
+		auto start = Clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			renderer.clearBuffers();
+			for (Mesh& mesh : meshes)
+				mesh.render(renderer, shader);
+		}
+		const double separate = secondsSince(start) / frames;
+
+		start = Clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			renderer.clearBuffers();
+			cube.renderInstanced(renderer, shader, instances);
+		}
+		const double instanced = secondsSince(start) / frames;
+
+		std::printf("%-28s %8.3f ms/frame %10.2f Mcubes/s\n", "separate meshes", separate * 1000,
+		            cubeCount / separate / 1e6);
+		std::printf("%-28s %8.3f ms/frame %10.2f Mcubes/s\n", "instanced", instanced * 1000,
+		            cubeCount / instanced / 1e6);
+	}
+
+	/**
+	 * \brief Renders an animated scene the way the demo does, and reports the distribution of the frame times
+	 */
+	void benchmarkFrames(int frames, unsigned threads)
+	{
+		constexpr int width = 1280, height = 720;
+
+		BenchmarkScene scene;
+		generateScene(scene, 300, 0.6f, 8, 5678);
+
+		Renderer renderer{ width, height, threads };
+		renderer.setClearColor({ 25, 255 });
+		renderer.setDeferred(true);
+		renderer.setCullMode(CullMode::Back);
+
+		const glm::mat4 persp = getPerspective(width, height);
+		SimpleShader shader{ persp, true };
+		RainbowShader rainbowShader{ persp, true };
+		OutlineShader outlineShader{ persp, true, { 20, 20, 20 } };
+		for (Light& light : scene.lights)
+		{
+			shader.addLight(light);
+			rainbowShader.addLight(light);
+			outlineShader.addLight(light);
+		}
+
+		shader.setUniform4fm("view", getView());
+		rainbowShader.setUniform4fm("view", getView());
+		rainbowShader.setUniform1fv("frequency", 300);
+		outlineShader.setUniform4fm("view", getView());
+		outlineShader.setUniform1fv("minThickness", 0.2f);
+		outlineShader.setUniform1fv("maxThickness", 0.4f);
+
+		// The meshes out of view or hidden by the ones drawn before them are skipped, like a real scene would
+		BoundingVolumeHierarchy hierarchy;
+		for (Mesh& mesh : scene.meshes)
+			hierarchy.insert(mesh);
+		const glm::mat4 viewProjection = persp * getView();
+		const Frustum frustum{ viewProjection };
+		std::vector<bool> visible;
+
+		std::vector<double> times;
+		times.reserve(frames);
+		for (int frame = 0; frame < frames; frame++)
+		{
+			// Fixed time steps, every run draws the same frames
+			const float time = frame / 60.0f;
+			rainbowShader.setUniform1fv(RainbowShader::TIME, time * 50);
+			outlineShader.setUniform1fv(OutlineShader::SIN_TIME, std::sin(time));
+
+			const auto start = Clock::now();
+			for (Mesh& mesh : scene.meshes)
+				mesh.setRotation(mesh.getRotation() + glm::vec3{ 1, 0.5f, 0 });
+
+			hierarchy.update();
+			hierarchy.cull(frustum, visible);
+
+			renderer.clearBuffers();
+			for (size_t i = 0; i < scene.meshes.size(); i++)
+			{
+				Mesh& mesh = scene.meshes[i];
+				if (!visible[i] || renderer.isOccluded(mesh.getWorldBounds(), viewProjection)) continue;
+
+				switch (i % 3)
+				{
+				case 0:
+					mesh.render(renderer, shader);
+					break;
+				case 1:
+					mesh.render(renderer, rainbowShader);
+					break;
+				default:
+					mesh.render(renderer, outlineShader);
+					break;
+				}
+			}
+			renderer.resolve();
+			times.push_back(secondsSince(start) * 1000);
+		}
+
+		std::sort(times.begin(), times.end());
+		const auto percentile = [&times](double p)
+		{
+			return times[std::min(times.size() - 1, static_cast<size_t>(p * times.size()))];
+		};
+
+		std::printf("%-28s p50 %8.3f ms  p90 %8.3f ms  p99 %8.3f ms  max %8.3f ms  (%u threads)\n", "frame 1280x720",
+		            percentile(0.5), percentile(0.9), percentile(0.99), times.back(), threads);
+	}
+}
+
+bool isBenchmark(int argc, char** argv)
+{
+	return argc > 1 && std::string{ argv[1] } == "--bench";
+}
+
+bool parseBenchmarkOptions(int argc, char** argv, BenchmarkOptions& options)
+{
+	for (int i = 2; i < argc; i++)
+	{
+		const std::string arg{ argv[i] };
+
+		if (arg == "--quick")
+			options.quick = true;
+		else if (arg == "--threads" && i + 1 < argc)
+		{
+			int threads;
+			if (!parsePositive(argv[++i], threads)) return false;
+			options.threads = threads;
+		}
+		else
+			return false;
+	}
+
+	return true;
+}
+
+int runBenchmark(const BenchmarkOptions& options)
+{
+	// Every benchmark runs for roughly the same time
+	const int iterations = options.quick ? 1 : 20;
+
+	std::printf("Rasterizer, 1280x720, single thread, unlit\n");
+	benchmarkRasterizer("small triangles (2000x0.1)", 2000, 0.1f, iterations);
+	benchmarkRasterizer("medium triangles (200x0.6)", 200, 0.6f, iterations);
+	benchmarkRasterizer("large triangles (20x3)", 20, 3, iterations);
+	benchmarkRasterizer("vertex stage (20000x0.005)", 20000, 0.005f, iterations);
+
+	std::printf("\nFragment shaders, 8 lights\n");
+	BenchmarkScene lights;
+	generateScene(lights, 0, 1, 8, 91011);
+	const glm::mat4 persp = getPerspective(1280, 720);
+
+	SimpleShader unlit{ persp, false };
+	SimpleShader shader{ persp, true };
+	RainbowShader rainbowShader{ persp, true };
+	rainbowShader.setUniform1fv("frequency", 300);
+	OutlineShader outlineShader{ persp, true, { 20, 20, 20 } };
+	outlineShader.setUniform1fv("minThickness", 0.2f);
+	outlineShader.setUniform1fv("maxThickness", 0.4f);
+	outlineShader.setUniform1fv("sinTime", 0.5f);
+	for (Light& light : lights.lights)
+	{
+		shader.addLight(light);
+		rainbowShader.addLight(light);
+		outlineShader.addLight(light);
+	}
+	for (SimpleShader* s : std::initializer_list<SimpleShader*>{ &unlit, &shader, &rainbowShader, &outlineShader })
+		s->setDrawUniforms({ glm::mat4{ 1 }, glm::mat4{ 1 } });
+
+	const int fragments = iterations * 100000;
+	benchmarkShader("SimpleShader (unlit)", unlit, fragments);
+	benchmarkShader("SimpleShader", shader, fragments);
+	benchmarkShader("RainbowShader", rainbowShader, fragments);
+	benchmarkShader("OutlineShader", outlineShader, fragments);
+
+	// Many lights, each reaching only a small part of the scene
+	BenchmarkScene localLights;
+	generateScene(localLights, 0, 1, 256, 121314);
+	SimpleShader localShader{ persp, true };
+	for (Light& light : localLights.lights)
+	{
+		light.setRadius(1.5f);
+		localShader.addLight(light);
+	}
+	localShader.setDrawUniforms({ glm::mat4{ 1 }, glm::mat4{ 1 } });
+	benchmarkShader("256 lights, radius 1.5", localShader, fragments);
+
+	// Random texels, so that neighbouring ones are rarely equal
+	std::vector<ofColor> texels(256 * 256);
+	std::mt19937 texelRandom{ 151617 };
+	for (ofColor& texel : texels)
+		texel = ofColor(texelRandom() % 256, texelRandom() % 256, texelRandom() % 256);
+	Texture texture{ 256, 256, texels };
+	TexturedShader texturedShader{ persp, false };
+	texturedShader.setDrawUniforms({ glm::mat4{ 1 }, glm::mat4{ 1 } });
+	texturedShader.setTexture(&texture);
+	const std::pair<const char*, TextureFilter> filters[] = { { "Textured, nearest (unlit)", TextureFilter::Nearest },
+	                                                          { "Textured, bilinear (unlit)", TextureFilter::Bilinear },
+	                                                          { "Textured, trilinear (unlit)", TextureFilter::Trilinear } };
+	for (const auto& filter : filters)
+	{
+		texture.setFilter(filter.second);
+		benchmarkShader(filter.first, texturedShader, fragments);
+	}
+
+	// A single light in front of the triangle, then the same light with a shadow map, a cube hiding part of the triangle
+	// from it, with hard then filtered shadows
+	Mesh shadowLightMesh = generateCube({ 0.3f, 0.3f, -2 }, glm::vec3{ 0.1f }, { 255, 255 });
+	Light shadowLight{ shadowLightMesh, 1, { 255, 255 } };
+	Mesh occluder = generateCube({ 0, 0, -1.2f }, glm::vec3{ 0.4f }, { 255, 255 });
+	Renderer shadowRenderer{ 256, 256, 1 };
+	ShadowMap shadowMap{ 256 };
+	shadowMap.render(shadowRenderer, shadowLightMesh.getPosition(), { &occluder });
+	SimpleShader shadowShader{ persp, true };
+	shadowShader.addLight(shadowLight);
+	shadowShader.setDrawUniforms({ glm::mat4{ 1 }, glm::mat4{ 1 } });
+	benchmarkShader("1 light", shadowShader, fragments);
+	shadowLight.setShadowMap(&shadowMap);
+	// The fragments only see the lights taken by updateLights(), benchmarkShader() doesn't begin any draw
+	shadowShader.updateLights();
+	shadowMap.setFilterRadius(0);
+	benchmarkShader("1 light, shadow map", shadowShader, fragments);
+	shadowMap.setFilterRadius(1);
+	benchmarkShader("1 light, shadow map, PCF 3x3", shadowShader, fragments);
+
+	// The lit shaders light batches of fragments side by side, with each instruction set the CPU supports
+	std::printf("\nFragment shaders, batches of %d fragments\n", FragmentBatch::MAX_SIZE);
+	const std::pair<const char*, SimdLevel> levels[] = { { "scalar", SimdLevel::Scalar },
+	                                                     { "SSE2", SimdLevel::SSE2 },
+	                                                     { "AVX2", SimdLevel::AVX2 } };
+	for (const auto& level : levels)
+	{
+		if (level.second > detectSimdLevel()) break;
+
+		benchmarkShaderBatches((std::string{ "8 lights, " } + level.first).c_str(), shader, fragments, level.second);
+		benchmarkShaderBatches((std::string{ "256 lights, " } + level.first).c_str(), localShader,
+		                       fragments, level.second);
+		benchmarkShaderBatches((std::string{ "1 light, PCF 3x3, " } + level.first).c_str(), shadowShader,
+		                       fragments, level.second);
+	}
+
+	std::printf("\nDepth-only passes, 1280x720, single thread\n");
+	benchmarkDepthPass("small triangles (2000x0.1)", 2000, 0.1f, iterations);
+	benchmarkDepthPass("medium triangles (200x0.6)", 200, 0.6f, iterations);
+	benchmarkDepthPass("large triangles (20x3)", 20, 3, iterations);
+
+	std::printf("\nShadow maps, 300 meshes, %u threads\n", options.threads);
+	benchmarkShadowMap(256, iterations, options.threads);
+	benchmarkShadowMap(1024, iterations, options.threads);
+
+	std::printf("\nCubes, 1280x720, unlit, %u threads\n", options.threads);
+	benchmarkInstancing(options.quick ? 2000 : 20000, iterations, options.threads);
+
+	std::printf("\nFrame times, 300 meshes, 3 shaders, 8 lights, deferred, culled\n");
+	benchmarkFrames(iterations * 5, options.threads);
+
+	return 0;
+}
@@ -0,0 +1,32 @@
+﻿#pragma once
+#include <thread>
+
+/**
+ * \brief The settings of a benchmark run, read from the command line
+ */
+struct BenchmarkOptions
+{
+	// Runs fewer iterations, to quickly check that nothing is broken
+	bool quick{ false };
+	// The threads used by the instancing and frame time benchmarks, the others always run on a single thread
+	unsigned threads{ std::thread::hardware_concurrency() };
+};
+
+/**
+ * \return true if the program was started with --bench as its first argument
+ */
+bool isBenchmark(int argc, char** argv);
+
+/**
+ * \brief Reads the options following --bench: --quick and --threads N
+ * \return false if an argument is unknown or invalid
+ */
+bool parseBenchmarkOptions(int argc, char** argv, BenchmarkOptions& options);
+
+/**
+ * \brief Measures the rasterizer, the vertex stage, the fragment shaders and the depth-only passes on fixed scenes, and
+ * prints the results.
+ * The scenes are generated from fixed seeds, so that the results of two builds can be compared
+ * \return the exit code of the program
+ */
+int runBenchmark(const BenchmarkOptions& options);
@@ -0,0 +1,189 @@
+﻿#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+	// Meshes without vertices have an empty box, they are all sorted at the origin
+	glm::vec3 getSortCenter(const BoundingBox& box)
+	{
+		return box.isEmpty() ? glm::vec3{} : box.getCenter();
+	}
+}
+
+int BoundingVolumeHierarchy::insert(Mesh& mesh)
+{
+	items.push_back({ &mesh, {}, {}, 0, -1 });
+	dirty = true;
+	return static_cast<int>(items.size()) - 1;
+}
+
+void BoundingVolumeHierarchy::clear()
+{
+	items.clear();
+	order.clear();
+	nodes.clear();
+	dirty = false;
+}
+
+size_t BoundingVolumeHierarchy::size() const
+{
+	return items.size();
+}
+
+void BoundingVolumeHierarchy::update()
+{
+	if (dirty)
+	{
+		build();
+		return;
+	}
+
+	bool refit = false;
+	for (Item& item : items)
+	{
+		if (item.mesh->getTransformVersion() == item.transformVersion) continue;
+		item.transformVersion = item.mesh->getTransformVersion();
+		item.sphere = item.mesh->getWorldSphere();
+
+		const BoundingBox& bounds = item.mesh->getWorldBounds();
+		if (bounds == item.bounds) continue;
+		item.bounds = bounds;
+		refit = true;
+
+		// Refit the leaf of the mesh and the nodes above it, until one of them keeps the same box
+		for (int index = item.node; index != -1; index = nodes[index].parent)
+		{
+			Node& node = nodes[index];
+
+			BoundingBox nodeBounds;
+			if (node.right == -1)
+			{
+				for (int i = node.first; i < node.first + node.count; i++)
+					nodeBounds.extend(items[order[i]].bounds);
+			}
+			else
+			{
+				nodeBounds.extend(nodes[index + 1].bounds);
+				nodeBounds.extend(nodes[node.right].bounds);
+			}
+
+			if (nodeBounds == node.bounds) break;
+			node.bounds = nodeBounds;
+		}
+	}
+
+	// Meshes moving far apart leave large overlapping boxes behind them, which a new tree gets rid of
+	if (refit && getTotalArea() > builtArea * REBUILD_RATIO)
+		build();
+}
+
+void BoundingVolumeHierarchy::cull(const Frustum& frustum, std::vector<bool>& visible) const
+{
+	visible.assign(items.size(), false);
+	if (nodes.empty()) return;
+
+	std::vector<int> stack{ 0 };
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		const int index = stack.back();
+		stack.pop_back();
+
+		const Containment containment = frustum.test(node.bounds);
+		if (containment == Containment::Outside) continue;
+
+		// Every mesh below a node inside of the frustum is visible, no need to test them
+		if (containment == Containment::Inside)
+		{
+			for (int i = node.first; i < node.first + node.count; i++)
+				visible[order[i]] = true;
+			continue;
+		}
+
+		if (node.right != -1)
+		{
+			stack.push_back(node.right);
+			stack.push_back(index + 1);
+			continue;
+		}
+
+		for (int i = node.first; i < node.first + node.count; i++)
+		{
+			// The sphere is cheaper to test, the box only has to be tested when the sphere crosses a plane
+			const Item& item = items[order[i]];
+			const Containment sphere = frustum.test(item.sphere);
+			visible[order[i]] = sphere == Containment::Inside ||
+			                    (sphere == Containment::Intersecting &&
+			                     frustum.test(item.bounds) != Containment::Outside);
+		}
+	}
+}
+
+void BoundingVolumeHierarchy::build()
+{
+	for (Item& item : items)
+	{
+		item.bounds = item.mesh->getWorldBounds();
+		item.sphere = item.mesh->getWorldSphere();
+		item.transformVersion = item.mesh->getTransformVersion();
+	}
+
+	order.resize(items.size());
+	std::iota(order.begin(), order.end(), 0);
+
+	nodes.clear();
+	if (!items.empty())
+		buildNode(0, static_cast<int>(items.size()), -1);
+
+	builtArea = getTotalArea();
+	dirty = false;
+}
+
+int BoundingVolumeHierarchy::buildNode(int first, int count, int parent)
+{
+	const int index = static_cast<int>(nodes.size());
+	nodes.push_back({ {}, first, count, -1, parent });
+
+	BoundingBox bounds;
+	BoundingBox centers;
+	for (int i = first; i < first + count; i++)
+	{
+		bounds.extend(items[order[i]].bounds);
+		centers.extend(getSortCenter(items[order[i]].bounds));
+	}
+	nodes[index].bounds = bounds;
+
+	if (count <= LEAF_SIZE)
+	{
+		for (int i = first; i < first + count; i++)
+			items[order[i]].node = index;
+		return index;
+	}
+
+	// Split the meshes in two halves along the axis where their centers are the most spread
+	const glm::vec3 spread = centers.max - centers.min;
+	const int axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : spread.y >= spread.z ? 1 : 2;
+
+	const int middle = first + count / 2;
+	std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + first + count,
+	                 [this, axis](int a, int b)
+	{
+		return getSortCenter(items[a].bounds)[axis] < getSortCenter(items[b].bounds)[axis];
+	});
+
+	buildNode(first, middle - first, index);
+	const int right = buildNode(middle, first + count - middle, index);
+	nodes[index].right = right;
+
+	return index;
+}
+
+float BoundingVolumeHierarchy::getTotalArea() const
+{
+	float area = 0;
+	for (const Node& node : nodes)
+		area += node.bounds.getSurfaceArea();
+	return area;
+}
@@ -0,0 +1,84 @@
+﻿#pragma once
+#include <vector>
+
+#include "Bounds.h"
+#include "Mesh.h"
+
+/**
+ * \brief A tree of boxes over the meshes of a scene, so that culling skips whole groups of meshes with a single test.
+ * When meshes move, only the boxes above them are refit; the tree is rebuilt once refitting has made it much worse
+ * than a fresh one
+ */
+class BoundingVolumeHierarchy
+{
+public:
+	// A leaf holds at most this many meshes
+	static constexpr int LEAF_SIZE = 4;
+	// The tree is rebuilt when the surface area of its nodes grows this much past the one it had when it was built
+	static constexpr float REBUILD_RATIO = 2;
+
+	/**
+	 * \brief Adds a mesh to the hierarchy, it must outlive it
+	 * \return the index of the mesh, the position of its flag in the results of cull()
+	 */
+	int insert(Mesh& mesh);
+	/**
+	 * \brief Removes all of the meshes
+	 */
+	void clear();
+	size_t size() const;
+
+	/**
+	 * \brief Builds the tree if meshes were inserted, otherwise refits the boxes of the meshes whose transform changed
+	 */
+	void update();
+
+	/**
+	 * \brief Finds the meshes at least partially inside of a frustum. The tree has to be up to date, see update()
+	 * \param visible the output, the flag of each mesh by index, true if it is visible
+	 */
+	void cull(const Frustum& frustum, std::vector<bool>& visible) const;
+
+private:
+	struct Item
+	{
+		Mesh* mesh;
+		// The world bounds of the mesh when the tree was last updated
+		BoundingBox bounds;
+		BoundingSphere sphere;
+		unsigned transformVersion;
+		// The leaf holding the mesh
+		int node;
+	};
+
+	/**
+	 * \brief The meshes of a node are always the ones from first to first + count in order, so a node entirely inside
+	 * of the frustum gives all of its meshes at once
+	 */
+	struct Node
+	{
+		BoundingBox bounds;
+		int first;
+		int count;
+		// The left child of a node is the one right after it, -1 for the leaves
+		int right;
+		int parent;
+	};
+
+	std::vector<Item> items;
+	// The indices of the items, in the order of the leaves
+	std::vector<int> order;
+	// The root first, each node followed by its left subtree
+	std::vector<Node> nodes;
+	bool dirty{ false };
+	// The surface area of the nodes right after the last build
+	float builtArea{ 0 };
+
+	void build();
+	/**
+	 * \brief Builds the subtree of the items from first to first + count in order
+	 * \return the index of its root
+	 */
+	int buildNode(int first, int count, int parent);
+	float getTotalArea() const;
+};
@@ -0,0 +1,128 @@
+﻿#include "Bounds.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+void BoundingBox::extend(const glm::vec3& point)
+{
+	min = glm::min(min, point);
+	max = glm::max(max, point);
+}
+
+void BoundingBox::extend(const BoundingBox& box)
+{
+	min = glm::min(min, box.min);
+	max = glm::max(max, box.max);
+}
+
+bool BoundingBox::isEmpty() const
+{
+	return min.x > max.x || min.y > max.y || min.z > max.z;
+}
+
+glm::vec3 BoundingBox::getCenter() const
+{
+	return (min + max) * 0.5f;
+}
+
+float BoundingBox::getSurfaceArea() const
+{
+	if (isEmpty()) return 0;
+
+	const glm::vec3 size = max - min;
+	return 2 * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+BoundingBox BoundingBox::transformed(const glm::mat4& matrix) const
+{
+	if (isEmpty()) return {};
+
+	/* Each axis of the transformed box spans the transformed center plus or minus the extents projected on that axis,
+	 * which is the same as transforming the eight corners without doing so
+	 */
+	const glm::vec3 center = getCenter();
+	const glm::vec3 extents = max - center;
+
+	const glm::vec3 newCenter{ matrix * glm::vec4{ center, 1 } };
+	glm::vec3 newExtents{};
+	for (int column = 0; column < 3; column++)
+		newExtents += glm::abs(glm::vec3{ matrix[column] }) * extents[column];
+
+	return { newCenter - newExtents, newCenter + newExtents };
+}
+
+bool BoundingBox::operator==(const BoundingBox& other) const
+{
+	return min == other.min && max == other.max;
+}
+
+bool BoundingBox::operator!=(const BoundingBox& other) const
+{
+	return !(*this == other);
+}
+
+BoundingSphere BoundingSphere::transformed(const glm::mat4& matrix) const
+{
+	// The radius grows with the largest scale of the three axes
+	const float scale = std::max({ glm::length(glm::vec3{ matrix[0] }), glm::length(glm::vec3{ matrix[1] }),
+	                               glm::length(glm::vec3{ matrix[2] }) });
+
+	return { glm::vec3{ matrix * glm::vec4{ center, 1 } }, radius * scale };
+}
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+	// glm matrices are stored by column, row i gives the i-th clip space coordinate of a point
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = { viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i] };
+
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[2];
+	planes[5] = rows[3] - rows[2];
+
+	for (auto& plane : planes)
+		plane /= glm::length(glm::vec3{ plane });
+}
+
+Containment Frustum::test(const BoundingBox& box) const
+{
+	if (box.isEmpty()) return Containment::Outside;
+
+	Containment result = Containment::Inside;
+	for (const auto& plane : planes)
+	{
+		const glm::vec3 normal{ plane };
+
+		// The corner furthest along the normal of the plane, and the one furthest behind it
+		glm::vec3 positive, negative;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			positive[axis] = normal[axis] >= 0 ? box.max[axis] : box.min[axis];
+			negative[axis] = normal[axis] >= 0 ? box.min[axis] : box.max[axis];
+		}
+
+		if (glm::dot(normal, positive) + plane.w < 0) return Containment::Outside;
+		if (glm::dot(normal, negative) + plane.w < 0) result = Containment::Intersecting;
+	}
+
+	return result;
+}
+
+Containment Frustum::test(const BoundingSphere& sphere) const
+{
+	Containment result = Containment::Inside;
+	for (const auto& plane : planes)
+	{
+		const float distance = glm::dot(glm::vec3{ plane }, sphere.center) + plane.w;
+
+		if (distance < -sphere.radius) return Containment::Outside;
+		if (distance < sphere.radius) result = Containment::Intersecting;
+	}
+
+	return result;
+}
@@ -0,0 +1,86 @@
+﻿#pragma once
+#include <limits>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+/**
+ * \brief An axis aligned bounding box, empty until a point is added to it
+ */
+struct BoundingBox
+{
+	glm::vec3 min{ std::numeric_limits<float>::infinity() };
+	glm::vec3 max{ -std::numeric_limits<float>::infinity() };
+
+	/**
+	 * \brief Grows the box so that it contains the given point
+	 */
+	void extend(const glm::vec3& point);
+	/**
+	 * \brief Grows the box so that it contains the given box
+	 */
+	void extend(const BoundingBox& box);
+
+	bool isEmpty() const;
+	glm::vec3 getCenter() const;
+	/**
+	 * \return the total area of the faces of the box, 0 if it is empty. The cost of a node of a bounding volume
+	 * hierarchy grows with it, as larger nodes are reached by more queries
+	 */
+	float getSurfaceArea() const;
+
+	/**
+	 * \return the smallest axis aligned box containing this one once transformed by the given matrix
+	 */
+	BoundingBox transformed(const glm::mat4& matrix) const;
+
+	bool operator==(const BoundingBox& other) const;
+	bool operator!=(const BoundingBox& other) const;
+};
+
+/**
+ * \brief A sphere containing an object, cheaper to test than a box but usually larger
+ */
+struct BoundingSphere
+{
+	glm::vec3 center{};
+	float radius{ 0 };
+
+	/**
+	 * \return a sphere containing this one once transformed by the given matrix, which may scale it unevenly
+	 */
+	BoundingSphere transformed(const glm::mat4& matrix) const;
+};
+
+/**
+ * \brief Where a bounding volume is relative to a frustum
+ */
+enum class Containment
+{
+	Outside,
+	Intersecting,
+	Inside
+};
+
+/**
+ * \brief The six planes of the volume seen by a camera, used to skip the objects out of view without transforming
+ * their vertices
+ */
+class Frustum
+{
+public:
+	/**
+	 * \brief Extracts the planes from the matrix going from world space to clip space. They bound the same volume as
+	 * the one the renderer clips against, -w <= x <= w, -w <= y <= w and 0 <= z <= w, so an object outside of the
+	 * frustum has none of its triangles drawn anyway
+	 * \param viewProjection the perspective matrix multiplied by the view matrix
+	 */
+	explicit Frustum(const glm::mat4& viewProjection);
+
+	Containment test(const BoundingBox& box) const;
+	Containment test(const BoundingSphere& sphere) const;
+
+private:
+	// a, b, c and d of the planes a * x + b * y + c * z + d = 0, the inside is positive and (a, b, c) has a length of 1
+	glm::vec4 planes[6];
+};
@@ -0,0 +1,67 @@
+﻿#include "CommandBuffer.h"
+
+class CommandBuffer::ClearCommand : public Command
+{
+public:
+	void execute(Renderer& renderer) override
+	{
+		renderer.clearBuffers();
+	}
+};
+
+class CommandBuffer::ResolveCommand : public Command
+{
+public:
+	void execute(Renderer& renderer) override
+	{
+		renderer.resolve();
+	}
+};
+
+CommandBuffer::CommandBuffer(Renderer& renderer) : renderer{ renderer }
+{
+}
+
+CommandBuffer::~CommandBuffer()
+{
+	// The commands and the vertex stage of the draws write into the buffer, their errors are lost
+	try
+	{
+		renderer.wait();
+		renderer.threads.wait(vertexStage);
+	}
+	catch (...)
+	{
+	}
+}
+
+void CommandBuffer::clearBuffers()
+{
+	commands.emplace_back(new ClearCommand{});
+}
+
+void CommandBuffer::resolve()
+{
+	commands.emplace_back(new ResolveCommand{});
+}
+
+void CommandBuffer::reset()
+{
+	renderer.threads.wait(vertexStage);
+	commands.clear();
+}
+
+void CommandBuffer::execute(Renderer& target)
+{
+	if (&target != &renderer)
+	{
+		std::cerr << "Error, a command buffer can only be submitted to the renderer it was recorded for";
+		throw std::bad_function_call();
+	}
+
+	// The vertex stage of the draws nobody started yet runs on this thread
+	renderer.threads.wait(vertexStage);
+
+	for (const auto& command : commands)
+		command->execute(target);
+}
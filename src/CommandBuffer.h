@@ -0,0 +1,137 @@
+﻿#pragma once
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <typeinfo>
+#include <vector>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "Renderer.h"
+#include "ShaderProgram.h"
+#include "VertexData.h"
+
+/**
+ * \brief Records the commands of a frame, for Renderer::submit() to execute them later on the renderer's threads.
+ * The shader of a draw is copied along with its uniforms, and its vertex stage starts on the renderer's threads as soon
+ * as it is recorded, so the next frame can be animated and transformed while the renderer rasterizes this one. The
+ * vertices, data and indices of the draws aren't copied, they must stay unchanged until the renderer is done with the
+ * buffer
+ */
+class CommandBuffer
+{
+public:
+	/**
+	 * \param renderer the renderer the buffer is submitted to, whose threads run the vertex stage of the draws
+	 */
+	CommandBuffer(Renderer& renderer);
+	CommandBuffer(const CommandBuffer&) = delete;
+	void operator=(const CommandBuffer&) = delete;
+	/**
+	 * \brief Waits for the renderer, which may still be executing the buffer
+	 */
+	~CommandBuffer();
+
+	/**
+	 * \brief Records Renderer::clearBuffers()
+	 */
+	void clearBuffers();
+	/**
+	 * \brief Records Renderer::drawIndexed() with the given shader, after running its vertex stage.
+	 * The shader is copied, so its actual type has to be ShaderT
+	 */
+	template <class ShaderT>
+	void drawIndexed(ShaderT& shader, const std::vector<glm::vec3>& vertices, const VertexData& data,
+	                 const std::vector<unsigned>& indices);
+	/**
+	 * \brief Records Renderer::resolve()
+	 */
+	void resolve();
+
+	/**
+	 * \brief Removes all of the commands, so that the next frame can be recorded into the buffer. Waits for the vertex
+	 * stage of the draws still running
+	 */
+	void reset();
+
+	/**
+	 * \brief Waits for the vertex stage of the draws, then executes the commands in the order they were recorded,
+	 * called by Renderer::submit()
+	 */
+	void execute(Renderer& renderer);
+
+private:
+	class Command
+	{
+	public:
+		virtual ~Command() = default;
+		virtual void execute(Renderer& renderer) = 0;
+	};
+
+	class ClearCommand;
+	class ResolveCommand;
+	/**
+	 * \brief Keeps a copy of the shader of a draw and the output of its vertex stage
+	 */
+	template <class ShaderT>
+	class DrawCommand;
+
+	Renderer& renderer;
+	std::vector<std::unique_ptr<Command>> commands;
+	// Done once the vertex stage of every recorded draw is
+	ThreadPool::Fence vertexStage;
+};
+
+template <class ShaderT>
+class CommandBuffer::DrawCommand : public Command
+{
+public:
+	DrawCommand(const ShaderT& shader, const VertexData& data, const std::vector<unsigned>& indices) :
+		shader{ shader }, data{ data }, indices{ indices } {}
+
+	void execute(Renderer& renderer) override
+	{
+		renderer.drawTransformed(shader, data, positions, outputs, indices);
+	}
+
+	ShaderT shader;
+	const VertexData& data;
+	const std::vector<unsigned>& indices;
+
+	std::vector<glm::vec4> positions;
+	VertexOutputs outputs;
+};
+
+template <class ShaderT>
+void CommandBuffer::drawIndexed(ShaderT& shader, const std::vector<glm::vec3>& vertices, const VertexData& data,
+                                const std::vector<unsigned>& indices)
+{
+	// Copying the shader through a reference to one of its base classes would slice it
+	if (typeid(shader) != typeid(ShaderT))
+	{
+		std::cerr << "Error, a recorded draw needs the actual type of its shader to copy it";
+		throw std::bad_function_call();
+	}
+
+	shader.beginDraw();
+
+	// Make sure the vertex data has everything the shader needs, fail if it doesn't
+	requireAttributes(shader, data, vertices.size());
+
+	std::unique_ptr<DrawCommand<ShaderT>> command{ new DrawCommand<ShaderT>{ shader, data, indices } };
+	command->positions.resize(vertices.size());
+	command->outputs.resize(vertices.size());
+
+	// Like Renderer::drawIndexed(), the vertices are transformed by chunks, here while the next draws are recorded
+	DrawCommand<ShaderT>* draw = command.get();
+	for (size_t begin = 0; begin < vertices.size(); begin += Renderer::VERTEX_CHUNK_SIZE)
+	{
+		const unsigned first = static_cast<unsigned>(begin);
+		const unsigned last = static_cast<unsigned>(std::min<size_t>(begin + Renderer::VERTEX_CHUNK_SIZE, vertices.size()));
+		renderer.threads.spawn(vertexStage, [draw, &vertices, &data, first, last]
+		{
+			runVertexStage(draw->shader, vertices, data, first, last, draw->positions, draw->outputs);
+		});
+	}
+	commands.push_back(std::move(command));
+}
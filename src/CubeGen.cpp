@@ -5,7 +5,7 @@
 // The coordinate values used for the cube vertices, in object space
 constexpr float MIN = -0.5f, MAX= -MIN;
 
-// The vertices of the triangles of a cube mesh
+// The vertices of the triangles of a cube mesh. Every triangle is counter-clockwise when seen from outside of the mesh
 std::vector<glm::vec3> cubeTriangles{
 	// Front bottom-left triangle
 	{MIN, MIN, MIN},
@@ -14,13 +14,13 @@ std::vector<glm::vec3> cubeTriangles{
 
 	// Front top-right triangle
 	{MAX, MIN, MIN},
-	{MAX, MAX, MIN},
 	{MIN, MAX, MIN},
+	{MAX, MAX, MIN},
 
 	// Back bottom-left triangle
 	{MIN, MIN, MAX},
-	{MIN, MAX, MAX},
 	{MAX, MIN, MAX},
+	{MIN, MAX, MAX},
 
 	// Back top-right triangle
 	{MAX, MIN, MAX},
@@ -29,13 +29,13 @@ std::vector<glm::vec3> cubeTriangles{
 
 	// Right bottom-left triangle
 	{MAX, MIN, MAX},
-	{MAX, MAX, MAX},
 	{MAX, MIN, MIN},
+	{MAX, MAX, MAX},
 
 	// Right, top-right triangle
 	{MAX, MAX, MAX},
-	{MAX, MAX, MIN},
 	{MAX, MIN, MIN},
+	{MAX, MAX, MIN},
 
 	// Left bottom-right triangle
 	{MIN, MIN, MAX},
@@ -49,8 +49,8 @@ std::vector<glm::vec3> cubeTriangles{
 
 	// Top bottom-left triangle
 	{MIN, MAX, MAX},
-	{MIN, MAX, MIN},
 	{MAX, MAX, MAX},
+	{MIN, MAX, MIN},
 
 	// Top top-right triangle
 	{MAX, MAX, MAX},
@@ -64,16 +64,17 @@ std::vector<glm::vec3> cubeTriangles{
 
 	// bottom top-right triangle
 	{MAX, MIN, MAX},
-	{MAX, MIN, MIN},
 	{MIN, MIN, MIN},
+	{MAX, MIN, MIN},
 };
 
 constexpr float PYR_Y = 0.25;
+// Counter-clockwise when seen from outside of the mesh, like the cube
 std::vector<glm::vec3> pyramidTriangles{
 	// Bottom base triangles
 	{MIN, PYR_Y, MIN},
-	{MAX, PYR_Y, MIN},
 	{MAX, PYR_Y, MAX},
+	{MAX, PYR_Y, MIN},
 
 	{MIN, PYR_Y, MIN},
 	{MIN, PYR_Y, MAX},
@@ -81,8 +82,8 @@ std::vector<glm::vec3> pyramidTriangles{
 
 	// Front facing triangle
 	{MIN, PYR_Y, MAX},
-	{MAX, PYR_Y, MAX},
 	{0, -PYR_Y, 0},
+	{MAX, PYR_Y, MAX},
 
 	// Back facing triangle
 	{MIN, PYR_Y, MIN},
@@ -91,8 +92,8 @@ std::vector<glm::vec3> pyramidTriangles{
 
 	// Left facing triangle
 	{MIN, PYR_Y, MIN},
-	{MIN, PYR_Y, MAX},
 	{0, -PYR_Y, 0},
+	{MIN, PYR_Y, MAX},
 
 	// Right facing triangle
 	{MAX, PYR_Y, MIN},
@@ -111,7 +112,7 @@ std::vector<glm::vec3> pyramidNormals{
 	{sinCos45, -sinCos45, 0}
 };
 
-std::vector<VertexData*> genCubeVertexData(ofColor color)
+VertexData genCubeVertexData(ofColor color)
 {
 	std::vector<glm::vec3> normals{
 		{0, 0, -1},
@@ -122,28 +123,35 @@ std::vector<VertexData*> genCubeVertexData(ofColor color)
 		{0, -1, 0}
 	};
 
-	std::vector<VertexData*> data{ };
+	VertexData data{ };
+	data.reserve(normals.size() * 6);
 	for (int i = 0; i < normals.size(); i++)
 	{
+		// Every face shows the whole texture, its u and v axes are the two axes the face spans, y pointing up
+		const int u = normals[i].x != 0 ? 2 : 0;
+		const int v = normals[i].y != 0 ? 2 : 1;
+
 		for (int j = 0; j < 6; j++) {
-			// This allocates on dynamic memory, the mesh destructor takes care of this!
-			auto posData = new PosVertexData(normals[i], color, {});
-			data.push_back(posData);
+			const glm::vec3& vertex = cubeTriangles[i * 6 + j];
+			data.normals.push_back(normals[i]);
+			data.colors.push_back(color);
+			data.uvs.push_back({ vertex[u] - MIN, MAX - vertex[v] });
 		}
 	}
 
 	return data;
 }
 
-std::vector<VertexData*> genPyramidVertexData(ofColor color)
+VertexData genPyramidVertexData(ofColor color)
 {
-	std::vector<VertexData*> data{};
+	VertexData data{};
+	data.reserve(pyramidNormals.size() * 3);
 
 	for (auto normal : pyramidNormals)
 	{
 		for (int i = 0; i < 3; i++) {
-			auto vertData = new PosVertexData(normal, color, {});
-			data.push_back(vertData);
+			data.normals.push_back(normal);
+			data.colors.push_back(color);
 		}
 	}
 
@@ -151,21 +159,21 @@ std::vector<VertexData*> genPyramidVertexData(ofColor color)
 }
 
 
-std::vector<VertexData*> genOctaVertexData(ofColor color)
+VertexData genOctaVertexData(ofColor color)
 {
-	std::vector<VertexData*> original{ genPyramidVertexData(color) };
-	std::vector<VertexData*> data{ };
+	const VertexData original{ genPyramidVertexData(color) };
+	VertexData data{ };
+	data.reserve((original.size() - 6) * 2);
 
-	data.insert(data.end(), original.begin() + 6, original.end());
+	for (size_t i = 6; i < original.size(); i++)
+		data.push_back(original, i);
 
 	for (int i = 6; i < original.size(); i++)
 	{
-		const auto vData = original[i];
-
-		glm::vec3 normal = vData->normal;
+		glm::vec3 normal = original.normals[i];
 		normal.y *= -1;
-		auto flip = new PosVertexData(normal, color, {});
-		data.push_back(flip);
+		data.normals.push_back(normal);
+		data.colors.push_back(color);
 	}
 
 	return data;
@@ -189,6 +197,10 @@ std::vector<glm::vec3> genOctaVertices()
 		verts[i].y *= -1;
 	}
 
+	// Mirroring reverses the winding of the flipped triangles, restore it
+	for (size_t i = 12; i < verts.size(); i += 3)
+		std::swap(verts[i + 1], verts[i + 2]);
+
 	return verts;
 }
 
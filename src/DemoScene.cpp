@@ -0,0 +1,117 @@
+﻿#include "DemoScene.h"
+
+#include <cmath>
+#include <glm/ext/matrix_clip_space.hpp>
+
+#include "CubeGen.h"
+
+DemoScene::DemoScene() :
+	shader{ getPerspective(), true }, unlit{ getPerspective(), false },
+	outlineShader{ getPerspective(), true, {20, 20, 20} }, rainbowShader{ getPerspective(), true },
+	cube{ generateCube({}, {1, 1, 1}, {255, 255, 255}) },
+	pyramid{ generatePyramid({2.5, 0, 0}, {1, 1, 1}, {120, 50, 130}) },
+	lightMesh{ generateCube({1.25, .5, 1}, glm::vec3{0.2f}, {255, 100, 10}) },
+	lightMesh2{ generateCube({1.25, -.5, -1}, glm::vec3{0.2f}, {0, 150, 255}) },
+	lightMesh3{ generateCube({}, {0.15, 0.15, 0.15}, {255, 255, 255}) },
+	light{ lightMesh, 2, {255, 100, 10} }, light2{ lightMesh2, 2, {0, 150, 255} }, light3{ lightMesh3, 0.5, {255, 255, 255} },
+	cam{ {0, 0, -4} }
+{
+	shader.addLight(light);
+	shader.addLight(light2);
+	shader.addLight(light3);
+
+	outlineShader.addLight(light);
+	outlineShader.addLight(light2);
+	outlineShader.addLight(light3);
+
+	rainbowShader.addLight(light);
+	rainbowShader.addLight(light2);
+	rainbowShader.addLight(light3);
+
+	outlineShader.setUniform1fv("minThickness", 0.2f);
+	outlineShader.setUniform1fv("maxThickness", 0.4f);
+
+	rainbowShader.setUniform1fv("frequency", 300);
+
+	hierarchy.insert(lightMesh);
+	hierarchy.insert(lightMesh2);
+	hierarchy.insert(lightMesh3);
+	hierarchy.insert(cube);
+	hierarchy.insert(pyramid);
+}
+
+void DemoScene::update(float time)
+{
+	const float sinTime = std::sin(time);
+
+	shader.setUniform4fm(SimpleShader::VIEW, cam.getMatrix());
+
+	outlineShader.setUniform4fm(OutlineShader::VIEW, cam.getMatrix());
+	outlineShader.setUniform1fv(OutlineShader::SIN_TIME, sinTime);
+
+	unlit.setUniform4fm(SimpleShader::VIEW, cam.getMatrix());
+
+	rainbowShader.setUniform4fm(RainbowShader::VIEW, cam.getMatrix());
+	rainbowShader.setUniform1fv(RainbowShader::TIME, time * 50);
+
+	cube.setRotation(glm::vec3{ time, 0, time } * 30.0f);
+	pyramid.setRotation(glm::vec3{ 0, 0, time * 20 });
+
+	const float invSin = std::sin(-time);
+	const float invCos = std::cos(-time);
+
+	lightMesh3.setPosition(pyramid.getPosition() + glm::vec3{ 0, invSin, invCos });
+}
+
+void DemoScene::render(Renderer& renderer)
+{
+	cull();
+	renderer.clearBuffers();
+
+	if (visible[LIGHT_MESH]) lightMesh.render(renderer, unlit);
+	if (visible[LIGHT_MESH_2]) lightMesh2.render(renderer, unlit);
+	if (visible[LIGHT_MESH_3]) lightMesh3.render(renderer, unlit);
+
+	if (visible[CUBE]) cube.render(renderer, outlineShader);
+
+	if (visible[PYRAMID]) pyramid.render(renderer, rainbowShader);
+
+	renderer.resolve();
+}
+
+void DemoScene::record(CommandBuffer& commands)
+{
+	cull();
+	commands.clearBuffers();
+
+	if (visible[LIGHT_MESH]) lightMesh.render(commands, unlit);
+	if (visible[LIGHT_MESH_2]) lightMesh2.render(commands, unlit);
+	if (visible[LIGHT_MESH_3]) lightMesh3.render(commands, unlit);
+
+	if (visible[CUBE]) cube.render(commands, outlineShader);
+
+	if (visible[PYRAMID]) pyramid.render(commands, rainbowShader);
+
+	commands.resolve();
+}
+
+void DemoScene::cull()
+{
+	hierarchy.update();
+	hierarchy.cull(Frustum{ getPerspective() * cam.getMatrix() }, visible);
+}
+
+Camera& DemoScene::getCamera()
+{
+	return cam;
+}
+
+Mesh& DemoScene::getCube()
+{
+	return cube;
+}
+
+glm::mat4 DemoScene::getPerspective()
+{
+	return glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
+}
@@ -0,0 +1,88 @@
+﻿#pragma once
+#include <vector>
+#include <glm/mat4x4.hpp>
+
+#include "BoundingVolumeHierarchy.h"
+#include "Camera.h"
+#include "CommandBuffer.h"
+#include "Light.h"
+#include "Mesh.h"
+#include "OutlineShader.h"
+#include "RainbowShader.h"
+#include "Renderer.h"
+#include "SimpleShader.h"
+
+/**
+ * \brief The scene shown by the demo: a few meshes, each with its own shader, lit by three colored lights.
+ * Shared by the window and by the headless renderer, so that both draw exactly the same frames
+ */
+class DemoScene
+{
+public:
+	DemoScene();
+	DemoScene(const DemoScene&) = delete;
+	void operator=(const DemoScene&) = delete;
+
+	/**
+	 * \brief Animates the scene and updates the uniforms of the shaders
+	 * \param time the time since the start of the animation, in seconds
+	 */
+	void update(float time);
+
+	/**
+	 * \brief Draws the meshes in view of the camera with the given renderer, after clearing its buffers
+	 */
+	void render(Renderer& renderer);
+	/**
+	 * \brief Records the same commands as render(), the scene must not be destroyed before they are executed
+	 */
+	void record(CommandBuffer& commands);
+
+	Camera& getCamera();
+	/**
+	 * \return the mesh rotated by the user with the arrow keys
+	 */
+	Mesh& getCube();
+
+	/**
+	 * \return the perspective matrix used by every shader of the scene
+	 */
+	static glm::mat4 getPerspective();
+
+private:
+	SimpleShader shader;
+	SimpleShader unlit;
+	OutlineShader outlineShader;
+	RainbowShader rainbowShader;
+
+	Mesh cube;
+	Mesh pyramid;
+
+	// Lights keep a reference to their mesh, the meshes have to be declared first
+	Mesh lightMesh;
+	Mesh lightMesh2;
+	Mesh lightMesh3;
+	Light light;
+	Light light2;
+	Light light3;
+
+	Camera cam;
+
+	// The meshes in the order they are inserted in the hierarchy, which is also the order they are drawn in
+	enum MeshIndex
+	{
+		LIGHT_MESH,
+		LIGHT_MESH_2,
+		LIGHT_MESH_3,
+		CUBE,
+		PYRAMID
+	};
+	BoundingVolumeHierarchy hierarchy;
+	// For every mesh, true if it is at least partially in view
+	std::vector<bool> visible;
+
+	/**
+	 * \brief Refits the hierarchy to the meshes that moved and finds the ones in view of the camera
+	 */
+	void cull();
+};
@@ -1,28 +1,91 @@
 ﻿#include "DepthBuffer.h"
 
 #include <algorithm>
+#include <utility>
 
-DepthBuffer::DepthBuffer(int w, int h) : width{ w }, height{ h }
+DepthBuffer::DepthBuffer(int w, int h) : width{ w }, height{ h },
+	stride{ (w + ROW_PADDING - 1) / ROW_PADDING * ROW_PADDING },
+	blocksX{ (w + BLOCK_SIZE - 1) / BLOCK_SIZE }, blocksY{ (h + BLOCK_SIZE - 1) / BLOCK_SIZE }
 {
-	buffer = new float[width * height];
+	buffer = new float[stride * height];
+	blockMax = new float[blocksX * blocksY];
 }
 
 DepthBuffer::~DepthBuffer()
 {
 	delete[] buffer;
+	delete[] blockMax;
 }
 
 void DepthBuffer::clear(float value) const
 {
-	std::fill_n(buffer, width * height, value);
+	std::fill_n(buffer, stride * height, value);
+	std::fill_n(blockMax, blocksX * blocksY, value);
 }
 
 float DepthBuffer::get(int x, int y) const
 {
-	return buffer[y * width + x];
+	return buffer[y * stride + x];
 }
 
 void DepthBuffer::set(int x, int y, float val) const
 {
-	buffer[y * width + x] = val;
+	buffer[y * stride + x] = val;
+
+	// The maximum can only be lowered by scanning the whole block, keeping it an upper bound is enough here
+	float& max = blockMax[y / BLOCK_SIZE * blocksX + x / BLOCK_SIZE];
+	max = std::max(max, val);
+}
+
+int DepthBuffer::getWidth() const
+{
+	return width;
+}
+
+int DepthBuffer::getHeight() const
+{
+	return height;
+}
+
+void DepthBuffer::swap(DepthBuffer& other)
+{
+	std::swap(buffer, other.buffer);
+	std::swap(width, other.width);
+	std::swap(height, other.height);
+	std::swap(stride, other.stride);
+	std::swap(blockMax, other.blockMax);
+	std::swap(blocksX, other.blocksX);
+	std::swap(blocksY, other.blocksY);
+}
+
+float* DepthBuffer::getRow(int y) const
+{
+	return buffer + y * stride;
+}
+
+float DepthBuffer::getBlockMax(int blockX, int blockY) const
+{
+	return blockMax[blockY * blocksX + blockX];
+}
+
+float DepthBuffer::getMaxDepth(int minX, int minY, int maxX, int maxY) const
+{
+	float max = blockMax[minY / BLOCK_SIZE * blocksX + minX / BLOCK_SIZE];
+	for (int blockY = minY / BLOCK_SIZE; blockY <= maxY / BLOCK_SIZE; blockY++)
+		for (int blockX = minX / BLOCK_SIZE; blockX <= maxX / BLOCK_SIZE; blockX++)
+			max = std::max(max, blockMax[blockY * blocksX + blockX]);
+	return max;
+}
+
+void DepthBuffer::updateBlock(int blockX, int blockY) const
+{
+	// Only the pixels of the screen are considered, the padding of the rows is never written
+	const int minX = blockX * BLOCK_SIZE, maxX = std::min(minX + BLOCK_SIZE, width);
+	const int minY = blockY * BLOCK_SIZE, maxY = std::min(minY + BLOCK_SIZE, height);
+
+	float max = buffer[minY * stride + minX];
+	for (int y = minY; y < maxY; y++)
+		for (int x = minX; x < maxX; x++)
+			max = std::max(max, buffer[y * stride + x]);
+	blockMax[blockY * blocksX + blockX] = max;
 }
@@ -19,9 +19,46 @@ public:
 	float get(int x, int y) const;
 	void set(int x, int y, float val) const;
 
+	int getWidth() const;
+	int getHeight() const;
+	/**
+	 * \brief Exchanges the values of two depth buffers, and their sizes, without copying them
+	 */
+	void swap(DepthBuffer& other);
+
+	/**
+	 * \return the first value of the given row. Rows are padded, so that reading up to ROW_PADDING values past the end of
+	 * a row is always allowed
+	 */
+	float* getRow(int y) const;
+
+	// The width of every row is rounded up to a multiple of this
+	static constexpr int ROW_PADDING = 8;
+	// The side of the square blocks of pixels whose maximum depth is tracked
+	static constexpr int BLOCK_SIZE = 8;
+
+	/**
+	 * \return a value greater than or equal to every depth stored in the given block. A fragment whose depth is greater
+	 * than or equal to it can't pass the depth test anywhere in the block
+	 */
+	float getBlockMax(int blockX, int blockY) const;
+	/**
+	 * \return a value greater than or equal to every depth stored in the blocks overlapping the given pixel bounds
+	 */
+	float getMaxDepth(int minX, int minY, int maxX, int maxY) const;
+	/**
+	 * \brief Recomputes the maximum depth of a block, must be called after writing to it through getRow()
+	 */
+	void updateBlock(int blockX, int blockY) const;
+
 	~DepthBuffer();
 private:
 	// It's a simple array behind the scenes
 	float* buffer;
 	int width, height;
+	// The distance between the start of two rows
+	int stride;
+	// The maximum depth of every block of BLOCK_SIZE x BLOCK_SIZE pixels, row by row
+	float* blockMax;
+	int blocksX, blocksY;
 };
@@ -0,0 +1,169 @@
+﻿#include "Headless.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <iostream>
+
+#include "DemoScene.h"
+#include "Renderer.h"
+
+namespace
+{
+	/**
+	 * \brief Writes the target as a binary PPM image. The alpha channel is dropped
+	 */
+	bool writePPM(const RenderTarget& target, const std::string& path)
+	{
+		std::ofstream file{ path, std::ios::binary };
+		if (!file) return false;
+
+		file << "P6\n" << target.getWidth() << " " << target.getHeight() << "\n255\n";
+
+		const unsigned char* data = target.getData();
+		const int pixelCount = target.getWidth() * target.getHeight();
+		for (int i = 0; i < pixelCount; i++)
+			file.write(reinterpret_cast<const char*>(data + i * RenderTarget::CHANNELS), 3);
+
+		return static_cast<bool>(file);
+	}
+}
+
+bool parsePositive(const std::string& text, int& value)
+{
+	try
+	{
+		size_t end;
+		value = std::stoi(text, &end);
+		return end == text.size() && value > 0;
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+}
+
+bool isHeadless(int argc, char** argv)
+{
+	return argc > 1 && std::string{ argv[1] } == "--headless";
+}
+
+bool parseHeadlessOptions(int argc, char** argv, HeadlessOptions& options)
+{
+	for (int i = 2; i < argc; i++)
+	{
+		const std::string arg{ argv[i] };
+		// Every option but --stats and --pin-threads has a value
+		const bool hasValue = i + 1 < argc;
+
+		if (arg == "--stats")
+			options.stats = true;
+		else if (arg == "--pin-threads")
+			options.pinThreads = true;
+		else if (arg == "--frames" && hasValue)
+		{
+			if (!parsePositive(argv[++i], options.frames)) return false;
+		}
+		else if (arg == "--threads" && hasValue)
+		{
+			int threads;
+			if (!parsePositive(argv[++i], threads)) return false;
+			options.threads = threads;
+		}
+		else if (arg == "--size" && hasValue)
+		{
+			const std::string size{ argv[++i] };
+			const size_t separator = size.find('x');
+			if (separator == std::string::npos) return false;
+
+			if (!parsePositive(size.substr(0, separator), options.width) ||
+				!parsePositive(size.substr(separator + 1), options.height))
+				return false;
+		}
+		else if (arg == "--frame-time" && hasValue)
+		{
+			try
+			{
+				options.frameTime = std::stof(argv[++i]);
+			}
+			catch (const std::exception&)
+			{
+				return false;
+			}
+		}
+		else if (arg == "--out" && hasValue)
+			options.outputDir = argv[++i];
+		else if (arg == "--trace" && hasValue)
+			options.tracePath = argv[++i];
+		else
+			return false;
+	}
+
+	return true;
+}
+
+int runHeadless(const HeadlessOptions& options)
+{
+	Renderer renderer{ options.width, options.height, options.threads, options.pinThreads };
+	renderer.setClearColor({ 25, 255 });
+	renderer.setDeferred(true);
+	renderer.setCullMode(CullMode::Back);
+	renderer.getTrace().setEnabled(!options.tracePath.empty());
+
+	DemoScene scene;
+	PipelineCounters totalCounters;
+	double writeSeconds = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < options.frames; frame++)
+	{
+		scene.update(frame * options.frameTime);
+		scene.render(renderer);
+		totalCounters.add(renderer.getCounters());
+
+		if (options.outputDir.empty()) continue;
+
+		// Writing to disk isn't part of the rendering, it is timed separately
+		const auto writeStart = std::chrono::steady_clock::now();
+
+		char name[32];
+		std::snprintf(name, sizeof(name), "/frame_%05d.ppm", frame);
+		const std::string path = options.outputDir + name;
+
+		if (!writePPM(renderer.getTarget(), path))
+		{
+			std::cerr << "Error, couldn't write " << path << std::endl;
+			return 1;
+		}
+
+		writeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - writeStart).count();
+	}
+
+	const double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	const double renderSeconds = totalSeconds - writeSeconds;
+
+	std::cout << options.frames << " frames at " << options.width << "x" << options.height << " with "
+		<< options.threads << " threads: " << renderSeconds * 1000 << " ms, "
+		<< options.frames / renderSeconds << " fps" << std::endl;
+
+	if (options.stats)
+	{
+		std::cout << "Pipeline counters of all of the frames:" << std::endl;
+		totalCounters.print(std::cout);
+	}
+
+	if (!options.tracePath.empty())
+	{
+		// The counters of a frame are recorded when the next one starts, the last one has no next frame
+		renderer.getTrace().recordCounters(renderer.getCounters(), TraceRecorder::Clock::now());
+
+		if (!renderer.getTrace().write(options.tracePath))
+		{
+			std::cerr << "Error, couldn't write " << options.tracePath << std::endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,53 @@
+﻿#pragma once
+#include <string>
+#include <thread>
+
+/**
+ * \brief The settings of a headless run, read from the command line
+ */
+struct HeadlessOptions
+{
+	// The number of frames to render
+	int frames{ 60 };
+	// The size of the render target, the same as the window's by default
+	int width{ 160 };
+	int height{ 200 };
+	unsigned threads{ std::thread::hardware_concurrency() };
+	// Bind each thread of the renderer to its own core
+	bool pinThreads{ false };
+	// The animation time between two frames, in seconds
+	float frameTime{ 1 / 60.0f };
+	// Where the frames are written, one file per frame. If empty, the frames are only rendered in memory
+	std::string outputDir;
+	// Print the pipeline counters of all of the frames
+	bool stats{ false };
+	// Where the timeline of the frames is written, as a Chrome trace. If empty, no timeline is recorded
+	std::string tracePath;
+};
+
+/**
+ * \brief Reads a positive integer argument, such as the value of --threads
+ * \param value the output
+ * \return false if the whole text isn't a positive integer
+ */
+bool parsePositive(const std::string& text, int& value);
+
+/**
+ * \return true if the program was started with --headless as its first argument
+ */
+bool isHeadless(int argc, char** argv);
+
+/**
+ * \brief Reads the options following --headless: --frames N, --size WxH, --threads N, --frame-time SECONDS, --out DIR,
+ * --stats, --trace FILE and --pin-threads
+ * \param options the output, options missing from the command line keep their value
+ * \return false if an argument is unknown or invalid
+ */
+bool parseHeadlessOptions(int argc, char** argv, HeadlessOptions& options);
+
+/**
+ * \brief Renders the frames of the demo scene without opening a window, as fast as possible, then prints how long it
+ * took
+ * \return the exit code of the program
+ */
+int runHeadless(const HeadlessOptions& options);
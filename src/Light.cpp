@@ -27,3 +27,22 @@ void Light::setColor(ofColor col)
 	color = col;
 }
 
+void Light::setRadius(float val)
+{
+	radius = val;
+}
+
+float Light::getRadius()
+{
+	return radius;
+}
+
+void Light::setShadowMap(const ShadowMap* map)
+{
+	shadowMap = map;
+}
+
+const ShadowMap* Light::getShadowMap()
+{
+	return shadowMap;
+}
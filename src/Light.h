@@ -1,6 +1,10 @@
 ﻿#pragma once
+#include <limits>
+
 #include "Mesh.h"
 
+class ShadowMap;
+
 class Light
 {
 public:
@@ -11,9 +15,23 @@ public:
 	float getIntensity();
 	ofColor getColor();
 	void setColor(ofColor col);
+	/**
+	 * \brief Sets the distance beyond which the light is ignored, infinite by default. Shaders only evaluate the lights
+	 * whose radius reaches the fragment, a small radius makes scenes with many lights much cheaper to shade
+	 */
+	void setRadius(float val);
+	float getRadius();
+	/**
+	 * \brief Sets the shadow map rendered from the position of the light, nullptr by default: the light then goes through
+	 * every surface. The map isn't copied, it must outlive the draws of the shaders using the light
+	 */
+	void setShadowMap(const ShadowMap* map);
+	const ShadowMap* getShadowMap();
 
 private:
 	Mesh& mesh;
 	float intensity;
 	ofColor color;
+	float radius{ std::numeric_limits<float>::infinity() };
+	const ShadowMap* shadowMap{ nullptr };
 };
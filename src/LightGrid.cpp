@@ -0,0 +1,146 @@
+﻿#include "LightGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+LightGrid::LightGrid(const std::vector<std::reference_wrapper<Light>>& source)
+{
+	constexpr float infinity = std::numeric_limits<float>::infinity();
+	glm::vec3 min{ infinity };
+	glm::vec3 max{ -infinity };
+	bool anyLocal = false;
+
+	lights.reserve(source.size());
+	for (unsigned i = 0; i < source.size(); i++)
+	{
+		Light& light = source[i].get();
+		lights.push_back({ light.getMesh().getPosition(), light.getIntensity(), light.getColor(), light.getRadius(),
+		                   light.getShadowMap() });
+
+		const LightData& data = lights.back();
+		if (std::isinf(data.radius))
+		{
+			globalLights.push_back(i);
+			continue;
+		}
+
+		anyLocal = true;
+		min = glm::min(min, data.position - glm::vec3{ data.radius });
+		max = glm::max(max, data.position + glm::vec3{ data.radius });
+	}
+
+	// Without lights to bin, every position gets the global lights
+	if (!anyLocal) return;
+
+	gridMin = min;
+	for (int axis = 0; axis < 3; axis++)
+		cellScale[axis] = CELLS / std::max(max[axis] - min[axis], 1e-3f);
+
+	// Count the lights of each cell, then fill the cells. The lights are added in order, so every cell lists them in the
+	// same order as the shader, and sums their colors the same way
+	constexpr int cellCount = CELLS * CELLS * CELLS;
+	cellStart.assign(cellCount + 1, 0);
+	for (unsigned i = 0; i < lights.size(); i++)
+	{
+		if (std::isinf(lights[i].radius))
+		{
+			for (int cell = 0; cell < cellCount; cell++)
+				cellStart[cell + 1]++;
+		}
+		else
+			forEachCell(lights[i], [this](int cell) { cellStart[cell + 1]++; });
+	}
+
+	for (int cell = 0; cell < cellCount; cell++)
+		cellStart[cell + 1] += cellStart[cell];
+
+	cellLights.resize(cellStart.back());
+	std::vector<unsigned> next{ cellStart.begin(), cellStart.end() - 1 };
+	for (unsigned i = 0; i < lights.size(); i++)
+	{
+		if (std::isinf(lights[i].radius))
+		{
+			for (int cell = 0; cell < cellCount; cell++)
+				cellLights[next[cell]++] = i;
+		}
+		else
+			forEachCell(lights[i], [this, &next, i](int cell) { cellLights[next[cell]++] = i; });
+	}
+}
+
+void LightGrid::getLights(const glm::vec3& position, const unsigned*& begin, const unsigned*& end) const
+{
+	int cell = 0;
+	bool inside = !cellStart.empty();
+	for (int axis = 2; axis >= 0 && inside; axis--)
+	{
+		const float coordinate = std::floor((position[axis] - gridMin[axis]) * cellScale[axis]);
+		inside = coordinate >= 0 && coordinate < CELLS;
+		cell = cell * CELLS + static_cast<int>(coordinate);
+	}
+
+	if (!inside)
+	{
+		begin = globalLights.data();
+		end = begin + globalLights.size();
+		return;
+	}
+
+	begin = cellLights.data() + cellStart[cell];
+	end = cellLights.data() + cellStart[cell + 1];
+}
+
+bool LightGrid::matches(const std::vector<std::reference_wrapper<Light>>& source) const
+{
+	if (source.size() != lights.size()) return false;
+
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		Light& light = source[i].get();
+		const LightData& data = lights[i];
+
+		if (light.getMesh().getPosition() != data.position || light.getIntensity() != data.intensity ||
+			light.getColor() != data.color || light.getRadius() != data.radius || light.getShadowMap() != data.shadowMap)
+			return false;
+	}
+
+	return true;
+}
+
+template <class Function>
+void LightGrid::forEachCell(const LightData& light, Function onCell) const
+{
+	// The range of cells covered by the bounding box of the light, along each axis
+	int first[3], last[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const float relative = light.position[axis] - gridMin[axis];
+		first[axis] = std::max(0, static_cast<int>(std::floor((relative - light.radius) * cellScale[axis])));
+		last[axis] = std::min(CELLS - 1, static_cast<int>(std::floor((relative + light.radius) * cellScale[axis])));
+	}
+
+	const float squaredRadius = light.radius * light.radius;
+	for (int z = first[2]; z <= last[2]; z++)
+	{
+		for (int y = first[1]; y <= last[1]; y++)
+		{
+			for (int x = first[0]; x <= last[0]; x++)
+			{
+				// The squared distance from the light to the closest point of the cell
+				const int cell[] = { x, y, z };
+				float squaredDistance = 0;
+				for (int axis = 0; axis < 3; axis++)
+				{
+					const float cellMin = gridMin[axis] + cell[axis] / cellScale[axis];
+					const float cellMax = gridMin[axis] + (cell[axis] + 1) / cellScale[axis];
+					const float closest = std::min(std::max(light.position[axis], cellMin), cellMax);
+					squaredDistance += (closest - light.position[axis]) * (closest - light.position[axis]);
+				}
+
+				if (squaredDistance <= squaredRadius)
+					onCell((z * CELLS + y) * CELLS + x);
+			}
+		}
+	}
+}
@@ -0,0 +1,78 @@
+﻿#pragma once
+#include <functional>
+#include <vector>
+#include <glm/vec3.hpp>
+
+#include "Light.h"
+#include "ofColor.h"
+
+/**
+ * \brief What the shaders read of a light, copied when the lights are binned
+ */
+struct LightData
+{
+	glm::vec3 position;
+	float intensity;
+	ofColor color;
+	// The light doesn't reach the fragments further than this
+	float radius;
+	// nullptr if the light casts no shadow
+	const ShadowMap* shadowMap;
+};
+
+/**
+ * \brief Bins the lights into a uniform grid of world space cells, so that shading a fragment only goes through the
+ * lights able to reach it. The cost of a fragment depends on the number of lights around it rather than on the total
+ * number of lights. Lights with an infinite radius reach every cell
+ */
+class LightGrid
+{
+public:
+	// The number of cells along each axis of the grid
+	static constexpr int CELLS = 16;
+
+	/**
+	 * \brief Copies the lights and bins them. The grid covers the lights with a finite radius, and only them
+	 */
+	explicit LightGrid(const std::vector<std::reference_wrapper<Light>>& lights);
+
+	/**
+	 * \brief Gets the lights which may reach a position, in the order they were given to the grid
+	 * \param position the world space position of a fragment
+	 * \param begin the first light index of the range
+	 * \param end past the last light index of the range
+	 */
+	void getLights(const glm::vec3& position, const unsigned*& begin, const unsigned*& end) const;
+
+	const LightData& getLight(unsigned index) const
+	{
+		return lights[index];
+	}
+
+	/**
+	 * \return true if the grid was made from the given lights, with their current settings
+	 */
+	bool matches(const std::vector<std::reference_wrapper<Light>>& lights) const;
+
+private:
+	std::vector<LightData> lights;
+	// The lights with an infinite radius, the only ones reaching the positions outside of the grid
+	std::vector<unsigned> globalLights;
+
+	// The indices of the lights reaching each cell, one cell after the other. The lights of cell i are the ones from
+	// cellStart[i] to cellStart[i + 1]. Empty if there is no light with a finite radius
+	std::vector<unsigned> cellLights;
+	std::vector<unsigned> cellStart;
+
+	// The world space corner of the first cell
+	glm::vec3 gridMin;
+	// The number of cells per world space unit, along each axis
+	glm::vec3 cellScale;
+
+	/**
+	 * \brief Gets the cells overlapped by a light: the cells of its bounding box whose closest point is within its radius
+	 * \param onCell called with the index of each cell
+	 */
+	template <class Function>
+	void forEachCell(const LightData& light, Function onCell) const;
+};
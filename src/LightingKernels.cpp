@@ -0,0 +1,320 @@
+﻿#include "LightingKernels.h"
+
+#include <cmath>
+
+#include "ShadowMap.h"
+
+void ScalarLighting::interpolate(const FragmentBatch& fragments, const TriangleContext& triangle,
+                                 const glm::mat4& normalTransform, LitFragments& lit)
+{
+	for (int lane = 0; lane < LitFragments::MAX_SIZE; lane++)
+	{
+		if ((fragments.lanes & 1u << lane) == 0) continue;
+
+		const float b0 = fragments.barycentric[0][lane];
+		const float b1 = fragments.barycentric[1][lane];
+		const float b2 = fragments.barycentric[2][lane];
+
+		float normal[3];
+		for (int i = 0; i < 3; i++)
+		{
+			lit.position[i][lane] = triangle.globalPos[0][i] * b0 + triangle.globalPos[1][i] * b1 +
+			                        triangle.globalPos[2][i] * b2;
+			normal[i] = triangle.normals[0][i] * b0 + triangle.normals[1][i] * b1 + triangle.normals[2][i] * b2;
+		}
+
+		const float scale = 1 / std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		for (int i = 0; i < 3; i++)
+			normal[i] = normal[i] * scale;
+
+		// The normal transform doesn't translate, only its upper 3x3 part applies to a direction
+		for (int i = 0; i < 3; i++)
+		{
+			lit.normal[i][lane] = normalTransform[0][i] * normal[0] + normalTransform[1][i] * normal[1] +
+			                      normalTransform[2][i] * normal[2];
+		}
+	}
+}
+
+void ScalarLighting::addLights(LitFragments& lit, unsigned lanes, const LightGrid& grid, const unsigned* first,
+                               const unsigned* last)
+{
+	for (const unsigned* index = first; index != last; index++)
+	{
+		const LightData& light = grid.getLight(*index);
+		float scale[3];
+		getLightScale(light, scale);
+
+		for (int lane = 0; lane < LitFragments::MAX_SIZE; lane++)
+		{
+			if ((lanes & 1u << lane) == 0) continue;
+
+			const float offsetX = light.position.x - lit.position[0][lane];
+			const float offsetY = light.position.y - lit.position[1][lane];
+			const float offsetZ = light.position.z - lit.position[2][lane];
+			const float distance = std::sqrt(offsetX * offsetX + offsetY * offsetY + offsetZ * offsetZ);
+			float dotP = (offsetX * lit.normal[0][lane] + offsetY * lit.normal[1][lane] +
+			              offsetZ * lit.normal[2][lane]) / distance;
+
+			// The cells of the light grid are coarse, the fragment may still be out of reach
+			if (!(distance <= light.radius && dotP > 0)) continue;
+
+			// Only the fragments facing the light are looked up in its shadow map
+			if (light.shadowMap != nullptr)
+			{
+				const glm::vec3 position{ lit.position[0][lane], lit.position[1][lane], lit.position[2][lane] };
+				const glm::vec3 normal{ lit.normal[0][lane], lit.normal[1][lane], lit.normal[2][lane] };
+				dotP = dotP * light.shadowMap->getVisibility(position, normal);
+				if (!(dotP > 0)) continue;
+			}
+
+			const float strength = dotP * (1 / (std::sqrt(distance) + 0.0001f));
+			for (int i = 0; i < 3; i++)
+				lit.color[i][lane] = lit.color[i][lane] + lit.base[i][lane] * (scale[i] * strength);
+		}
+	}
+}
+
+#ifdef FAKEGL_X86
+namespace
+{
+	/**
+	 * \return all of the bits of the lanes whose bit is set in the first 4 bits of lanes, the other lanes cleared
+	 */
+	__m128 expandLanes(unsigned lanes)
+	{
+		const __m128i bits = _mm_set_epi32(8, 4, 2, 1);
+		const __m128i set = _mm_and_si128(_mm_set1_epi32(static_cast<int>(lanes)), bits);
+		return _mm_castsi128_ps(_mm_cmpeq_epi32(set, bits));
+	}
+
+	FAKEGL_TARGET_AVX2
+	__m256 expandLanes8(unsigned lanes)
+	{
+		const __m256i bits = _mm256_set_epi32(128, 64, 32, 16, 8, 4, 2, 1);
+		const __m256i set = _mm256_and_si256(_mm256_set1_epi32(static_cast<int>(lanes)), bits);
+		return _mm256_castsi256_ps(_mm256_cmpeq_epi32(set, bits));
+	}
+}
+
+void Sse2Lighting::interpolate(const FragmentBatch& fragments, const TriangleContext& triangle,
+                               const glm::mat4& normalTransform, LitFragments& lit)
+{
+	for (int group = 0; group < LitFragments::MAX_SIZE; group += WIDTH)
+	{
+		if ((fragments.lanes >> group & 0xF) == 0) continue;
+
+		const __m128 b0 = _mm_loadu_ps(&fragments.barycentric[0][group]);
+		const __m128 b1 = _mm_loadu_ps(&fragments.barycentric[1][group]);
+		const __m128 b2 = _mm_loadu_ps(&fragments.barycentric[2][group]);
+
+		__m128 normal[3];
+		for (int i = 0; i < 3; i++)
+		{
+			const __m128 position = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.globalPos[0][i]), b0),
+			                                              _mm_mul_ps(_mm_set1_ps(triangle.globalPos[1][i]), b1)),
+			                                   _mm_mul_ps(_mm_set1_ps(triangle.globalPos[2][i]), b2));
+			_mm_storeu_ps(&lit.position[i][group], position);
+			normal[i] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.normals[0][i]), b0),
+			                                  _mm_mul_ps(_mm_set1_ps(triangle.normals[1][i]), b1)),
+			                       _mm_mul_ps(_mm_set1_ps(triangle.normals[2][i]), b2));
+		}
+
+		const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(normal[0], normal[0]),
+		                                                        _mm_mul_ps(normal[1], normal[1])),
+		                                             _mm_mul_ps(normal[2], normal[2])));
+		const __m128 scale = _mm_div_ps(_mm_set1_ps(1), length);
+		for (int i = 0; i < 3; i++)
+			normal[i] = _mm_mul_ps(normal[i], scale);
+
+		for (int i = 0; i < 3; i++)
+		{
+			const __m128 transformed = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(normalTransform[0][i]), normal[0]),
+			                                                 _mm_mul_ps(_mm_set1_ps(normalTransform[1][i]), normal[1])),
+			                                      _mm_mul_ps(_mm_set1_ps(normalTransform[2][i]), normal[2]));
+			_mm_storeu_ps(&lit.normal[i][group], transformed);
+		}
+	}
+}
+
+void Sse2Lighting::addLights(LitFragments& lit, unsigned lanes, const LightGrid& grid, const unsigned* first,
+                             const unsigned* last)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1);
+	const __m128 epsilon = _mm_set1_ps(0.0001f);
+
+	for (int group = 0; group < LitFragments::MAX_SIZE; group += WIDTH)
+	{
+		const unsigned groupLanes = lanes >> group & 0xF;
+		if (groupLanes == 0) continue;
+
+		const __m128 inGroup = expandLanes(groupLanes);
+		__m128 position[3], normal[3], base[3], color[3];
+		for (int i = 0; i < 3; i++)
+		{
+			position[i] = _mm_loadu_ps(&lit.position[i][group]);
+			normal[i] = _mm_loadu_ps(&lit.normal[i][group]);
+			base[i] = _mm_loadu_ps(&lit.base[i][group]);
+			color[i] = _mm_loadu_ps(&lit.color[i][group]);
+		}
+
+		for (const unsigned* index = first; index != last; index++)
+		{
+			const LightData& light = grid.getLight(*index);
+
+			const __m128 offsetX = _mm_sub_ps(_mm_set1_ps(light.position.x), position[0]);
+			const __m128 offsetY = _mm_sub_ps(_mm_set1_ps(light.position.y), position[1]);
+			const __m128 offsetZ = _mm_sub_ps(_mm_set1_ps(light.position.z), position[2]);
+			const __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(offsetX, offsetX),
+			                                                          _mm_mul_ps(offsetY, offsetY)),
+			                                               _mm_mul_ps(offsetZ, offsetZ)));
+			__m128 dotP = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(offsetX, normal[0]),
+			                                               _mm_mul_ps(offsetY, normal[1])),
+			                                    _mm_mul_ps(offsetZ, normal[2])),
+			                         distance);
+
+			__m128 reached = _mm_and_ps(inGroup, _mm_and_ps(_mm_cmple_ps(distance, _mm_set1_ps(light.radius)),
+			                                                _mm_cmpgt_ps(dotP, zero)));
+			const unsigned reachedLanes = static_cast<unsigned>(_mm_movemask_ps(reached));
+			if (reachedLanes == 0) continue;
+
+			if (light.shadowMap != nullptr)
+			{
+				float dots[WIDTH];
+				_mm_storeu_ps(dots, dotP);
+				for (int lane = 0; lane < WIDTH; lane++)
+				{
+					if ((reachedLanes & 1u << lane) == 0) continue;
+
+					const glm::vec3 fragmentPosition{ lit.position[0][group + lane], lit.position[1][group + lane],
+					                                  lit.position[2][group + lane] };
+					const glm::vec3 fragmentNormal{ lit.normal[0][group + lane], lit.normal[1][group + lane],
+					                                lit.normal[2][group + lane] };
+					dots[lane] = dots[lane] * light.shadowMap->getVisibility(fragmentPosition, fragmentNormal);
+				}
+				dotP = _mm_loadu_ps(dots);
+				reached = _mm_and_ps(reached, _mm_cmpgt_ps(dotP, zero));
+			}
+
+			const __m128 falloff = _mm_div_ps(one, _mm_add_ps(_mm_sqrt_ps(distance), epsilon));
+			const __m128 strength = _mm_and_ps(reached, _mm_mul_ps(dotP, falloff));
+
+			float scale[3];
+			getLightScale(light, scale);
+			for (int i = 0; i < 3; i++)
+				color[i] = _mm_add_ps(color[i], _mm_mul_ps(base[i], _mm_mul_ps(_mm_set1_ps(scale[i]), strength)));
+		}
+
+		for (int i = 0; i < 3; i++)
+			_mm_storeu_ps(&lit.color[i][group], color[i]);
+	}
+}
+
+FAKEGL_TARGET_AVX2
+void Avx2Lighting::interpolate(const FragmentBatch& fragments, const TriangleContext& triangle,
+                               const glm::mat4& normalTransform, LitFragments& lit)
+{
+	const __m256 b0 = _mm256_loadu_ps(fragments.barycentric[0]);
+	const __m256 b1 = _mm256_loadu_ps(fragments.barycentric[1]);
+	const __m256 b2 = _mm256_loadu_ps(fragments.barycentric[2]);
+
+	__m256 normal[3];
+	for (int i = 0; i < 3; i++)
+	{
+		const __m256 position = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.globalPos[0][i]), b0),
+		                                                    _mm256_mul_ps(_mm256_set1_ps(triangle.globalPos[1][i]), b1)),
+		                                      _mm256_mul_ps(_mm256_set1_ps(triangle.globalPos[2][i]), b2));
+		_mm256_storeu_ps(lit.position[i], position);
+		normal[i] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.normals[0][i]), b0),
+		                                        _mm256_mul_ps(_mm256_set1_ps(triangle.normals[1][i]), b1)),
+		                          _mm256_mul_ps(_mm256_set1_ps(triangle.normals[2][i]), b2));
+	}
+
+	const __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(normal[0], normal[0]),
+	                                                                 _mm256_mul_ps(normal[1], normal[1])),
+	                                                   _mm256_mul_ps(normal[2], normal[2])));
+	const __m256 scale = _mm256_div_ps(_mm256_set1_ps(1), length);
+	for (int i = 0; i < 3; i++)
+		normal[i] = _mm256_mul_ps(normal[i], scale);
+
+	for (int i = 0; i < 3; i++)
+	{
+		const __m256 transformed = _mm256_add_ps(
+			_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(normalTransform[0][i]), normal[0]),
+			              _mm256_mul_ps(_mm256_set1_ps(normalTransform[1][i]), normal[1])),
+			_mm256_mul_ps(_mm256_set1_ps(normalTransform[2][i]), normal[2]));
+		_mm256_storeu_ps(lit.normal[i], transformed);
+	}
+}
+
+FAKEGL_TARGET_AVX2
+void Avx2Lighting::addLights(LitFragments& lit, unsigned lanes, const LightGrid& grid, const unsigned* first,
+                             const unsigned* last)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1);
+	const __m256 epsilon = _mm256_set1_ps(0.0001f);
+
+	const __m256 inBatch = expandLanes8(lanes);
+	__m256 position[3], normal[3], base[3], color[3];
+	for (int i = 0; i < 3; i++)
+	{
+		position[i] = _mm256_loadu_ps(lit.position[i]);
+		normal[i] = _mm256_loadu_ps(lit.normal[i]);
+		base[i] = _mm256_loadu_ps(lit.base[i]);
+		color[i] = _mm256_loadu_ps(lit.color[i]);
+	}
+
+	for (const unsigned* index = first; index != last; index++)
+	{
+		const LightData& light = grid.getLight(*index);
+
+		const __m256 offsetX = _mm256_sub_ps(_mm256_set1_ps(light.position.x), position[0]);
+		const __m256 offsetY = _mm256_sub_ps(_mm256_set1_ps(light.position.y), position[1]);
+		const __m256 offsetZ = _mm256_sub_ps(_mm256_set1_ps(light.position.z), position[2]);
+		const __m256 distance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(offsetX, offsetX),
+		                                                                   _mm256_mul_ps(offsetY, offsetY)),
+		                                                     _mm256_mul_ps(offsetZ, offsetZ)));
+		__m256 dotP = _mm256_div_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(offsetX, normal[0]),
+		                                                        _mm256_mul_ps(offsetY, normal[1])),
+		                                          _mm256_mul_ps(offsetZ, normal[2])),
+		                            distance);
+
+		const __m256 inRadius = _mm256_cmp_ps(distance, _mm256_set1_ps(light.radius), _CMP_LE_OQ);
+		__m256 reached = _mm256_and_ps(inBatch, _mm256_and_ps(inRadius, _mm256_cmp_ps(dotP, zero, _CMP_GT_OQ)));
+		const unsigned reachedLanes = static_cast<unsigned>(_mm256_movemask_ps(reached));
+		if (reachedLanes == 0) continue;
+
+		if (light.shadowMap != nullptr)
+		{
+			float dots[WIDTH];
+			_mm256_storeu_ps(dots, dotP);
+			for (int lane = 0; lane < WIDTH; lane++)
+			{
+				if ((reachedLanes & 1u << lane) == 0) continue;
+
+				const glm::vec3 fragmentPosition{ lit.position[0][lane], lit.position[1][lane], lit.position[2][lane] };
+				const glm::vec3 fragmentNormal{ lit.normal[0][lane], lit.normal[1][lane], lit.normal[2][lane] };
+				dots[lane] = dots[lane] * light.shadowMap->getVisibility(fragmentPosition, fragmentNormal);
+			}
+			dotP = _mm256_loadu_ps(dots);
+			reached = _mm256_and_ps(reached, _mm256_cmp_ps(dotP, zero, _CMP_GT_OQ));
+		}
+
+		const __m256 falloff = _mm256_div_ps(one, _mm256_add_ps(_mm256_sqrt_ps(distance), epsilon));
+		const __m256 strength = _mm256_and_ps(reached, _mm256_mul_ps(dotP, falloff));
+
+		float scale[3];
+		getLightScale(light, scale);
+		for (int i = 0; i < 3; i++)
+		{
+			color[i] = _mm256_add_ps(color[i],
+			                         _mm256_mul_ps(base[i], _mm256_mul_ps(_mm256_set1_ps(scale[i]), strength)));
+		}
+	}
+
+	for (int i = 0; i < 3; i++)
+		_mm256_storeu_ps(lit.color[i], color[i]);
+}
+#endif
@@ -0,0 +1,97 @@
+﻿#pragma once
+#include <glm/mat4x4.hpp>
+
+#include "LightGrid.h"
+#include "RasterKernels.h"
+#include "ShaderProgram.h"
+
+/**
+ * \brief The fragments of a batch being lit, in the same lanes. Each value is an array over the lanes, so that the
+ * kernels load it for several fragments at once
+ */
+struct LitFragments
+{
+	static constexpr int MAX_SIZE = FragmentBatch::MAX_SIZE;
+
+	// In world space
+	float position[3][MAX_SIZE];
+	float normal[3][MAX_SIZE];
+	// The material color of the fragments, each channel from 0 to 255
+	float base[3][MAX_SIZE];
+	// The light accumulated so far, in the same range. Starts with the ambient light
+	float color[3][MAX_SIZE];
+};
+
+/**
+ * \brief Gets what a light adds to a fragment for each channel of its material color, at full strength
+ */
+inline void getLightScale(const LightData& light, float* scale)
+{
+	for (int i = 0; i < 3; i++)
+		scale[i] = light.color[i] / 255.0f * light.intensity * 0.5f;
+}
+
+/*
+ * The kernels below light the fragments of a batch, for SimpleShader. The world space position and normal of the
+ * fragments are interpolated once, then every light is a loop over the lanes:
+ *   offset = light - position, distance = |offset|, N.L = dot(offset, normal) / distance
+ *   a light reaches the fragment within its radius and when N.L > 0, N.L being multiplied by its shadow map visibility
+ *   color += base * scale * N.L / (sqrt(distance) + 0.0001), scale from getLightScale()
+ * Every kernel does exactly the same float operations in the same order, the lanes of a fragment no matter which, so
+ * that the same fragment gets the same color from all of them, bit by bit.
+ */
+
+/**
+ * \brief Lights the fragments one at a time. Used when no SIMD instruction set is available
+ */
+struct ScalarLighting
+{
+	/**
+	 * \brief Interpolates the world space position and normal of the fragments
+	 * \param fragments the barycentric coordinates of the fragments
+	 * \param triangle the data of the vertices of the triangle containing the fragments
+	 * \param normalTransform turns the interpolated normals to world space
+	 * \param lit the output
+	 */
+	static void interpolate(const FragmentBatch& fragments, const TriangleContext& triangle,
+	                        const glm::mat4& normalTransform, LitFragments& lit);
+	/**
+	 * \brief Adds the diffuse light of a range of lights to some of the fragments
+	 * \param lanes a bit for every fragment to light
+	 * \param grid the lights
+	 * \param first the index of the first light, in the grid
+	 * \param last past the index of the last light
+	 */
+	static void addLights(LitFragments& lit, unsigned lanes, const LightGrid& grid, const unsigned* first,
+	                      const unsigned* last);
+};
+
+#ifdef FAKEGL_X86
+/**
+ * \brief Lights the fragments 4 at a time with SSE2
+ */
+struct Sse2Lighting
+{
+	static constexpr int WIDTH = 4;
+
+	static void interpolate(const FragmentBatch& fragments, const TriangleContext& triangle,
+	                        const glm::mat4& normalTransform, LitFragments& lit);
+	static void addLights(LitFragments& lit, unsigned lanes, const LightGrid& grid, const unsigned* first,
+	                      const unsigned* last);
+};
+
+/**
+ * \brief Lights the fragments 8 at a time with AVX2
+ */
+struct Avx2Lighting
+{
+	static constexpr int WIDTH = 8;
+
+	FAKEGL_TARGET_AVX2
+	static void interpolate(const FragmentBatch& fragments, const TriangleContext& triangle,
+	                        const glm::mat4& normalTransform, LitFragments& lit);
+	FAKEGL_TARGET_AVX2
+	static void addLights(LitFragments& lit, unsigned lanes, const LightGrid& grid, const unsigned* first,
+	                      const unsigned* last);
+};
+#endif
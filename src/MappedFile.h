@@ -0,0 +1,37 @@
+﻿#pragma once
+#include <cstddef>
+#include <string>
+
+/**
+ * \brief A file mapped read-only in memory. Its pages are only read from the disk when they are first touched, and are
+ * shared by every process mapping the same file
+ */
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+
+	void operator=(const MappedFile&) = delete;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	/**
+	 * \brief Maps the whole file, closing the one mapped before
+	 * \return false if the file can't be opened or is empty
+	 */
+	bool open(const std::string& path);
+	/**
+	 * \brief Unmaps the file, the pointers returned by getData() become invalid
+	 */
+	void close();
+
+	bool isOpen() const;
+	const unsigned char* getData() const;
+	size_t getSize() const;
+
+	~MappedFile();
+private:
+	const unsigned char* data{ nullptr };
+	size_t size{ 0 };
+};
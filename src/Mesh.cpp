@@ -1,39 +1,61 @@
 ﻿#include "Mesh.h"
 
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
 #include <glm/ext/matrix_transform.hpp>
 
-Mesh::Mesh(std::vector<glm::vec3> vertices, std::vector<VertexData*>&& vertData) :
-	position{}, scale{ 1 }, rotation{}, verts{ vertices }, vertexData{ vertData }, matrixDirty{ true } {}
-
-Mesh::Mesh(Mesh&& other)
+namespace
 {
-	verts = other.verts;
-	vertexData = other.vertexData;
-	position = other.position;
-	scale = other.scale;
-	rotation = other.rotation;
-	matrixDirty = other.matrixDirty;
-	matrix = other.matrix;
+	// Two vertices can be merged when they have the same position and equal data
+	using VertexKey = std::tuple<float, float, float, float, float, float, unsigned, float, float>;
 
-	// Remove the pointers from the original so that the vertex data is not deallocated other is destroyed
-	other.vertexData.clear();
-}
+	VertexKey makeKey(const glm::vec3& pos, const VertexData& data, size_t index)
+	{
+		const glm::vec3& normal = data.normals[index];
+		const ofColor& col = data.colors[index];
+		const glm::vec2 uv = data.uvs.empty() ? glm::vec2{} : data.uvs[index];
 
+		const unsigned color = unsigned{ col.r } << 24 | unsigned{ col.g } << 16 | unsigned{ col.b } << 8 | col.a;
+		return { pos.x, pos.y, pos.z, normal.x, normal.y, normal.z, color, uv.x, uv.y };
+	}
+}
 
-Mesh& Mesh::operator=(Mesh&& other)
+Mesh::Mesh(std::vector<glm::vec3> vertices, const VertexData& vertData) :
+	position{}, scale{ 1 }, rotation{}, matrixDirty{ true }
 {
-	verts = other.verts;
-	vertexData = other.vertexData;
-	position = other.position;
-	scale = other.scale;
-	rotation = other.rotation;
-	matrixDirty = other.matrixDirty;
-	matrix = other.matrix;
+	std::map<VertexKey, unsigned> uniqueVertices{};
+	indices.reserve(vertices.size());
 
-	// Remove the pointers from the original so that the vertex data is not deallocated other is destroyed
-	other.vertexData.clear();
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		/* The reason modulo is used is because it makes it possible to give fewer VertexData elements than there are vertices
+		 * In that case, it wraps around for vertex indices that are >= vertexData.size()
+		 * It's mostly for experimentation, as this would NEVER happen in a real use case, but it doesn't cost anything to
+		 * leave it here for future tests!
+		 */
+		const size_t dataIndex = i % vertData.size();
+
+		const auto inserted = uniqueVertices.insert({ makeKey(vertices[i], vertData, dataIndex), static_cast<unsigned>(verts.size()) });
+		if (inserted.second)
+		{
+			verts.push_back(vertices[i]);
+			vertexData.push_back(vertData, dataIndex);
+		}
+
+		indices.push_back(inserted.first->second);
+	}
 
-	return *this;
+	computeBounds();
+}
+
+Mesh::Mesh(std::vector<glm::vec3> vertices, std::vector<unsigned> indices, VertexData vertData) :
+	verts{ std::move(vertices) }, vertexData{ std::move(vertData) }, indices{ std::move(indices) },
+	position{}, scale{ 1 }, rotation{}, matrixDirty{ true }
+{
+	computeBounds();
 }
 
 
@@ -41,16 +63,18 @@ void Mesh::render(Renderer& renderer)
 {
 	updateMatrix();
 
-	// Iterate over every triangle, notice the += 3 increment
-	for (int i = 0; i < verts.size(); i += 3)
-	{
-		// Set the global transform used by the shader
-		renderer.getShader()->setUniform4fm("transform", matrix);
+	// Set the global transform used by the shader
+	renderer.getShader()->setDrawUniforms({ matrix, normalMatrix });
 
-		// Pass the vertex positions and the triangle data to the renderer
-		const std::vector<VertexData*> vData{ getTriangleData(i) };
-		renderer.renderTriangle(verts.data() + i, vData);
-	}
+	// Pass the vertices, their data and the triangles to the renderer
+	renderer.drawIndexed(verts, vertexData, indices);
+}
+
+void Mesh::renderDepth(Renderer& renderer, const glm::mat4& viewProjection)
+{
+	updateMatrix();
+
+	renderer.drawDepth(verts, indices, viewProjection * matrix);
 }
 
 void Mesh::updateMatrix()
@@ -65,24 +89,24 @@ void Mesh::updateMatrix()
 	matrix = rotate(matrix, glm::radians(rotation.z), glm::vec3(0, 0, 1));
 
 	matrix = glm::scale(matrix, scale);
+	normalMatrix = transpose(inverse(matrix));
+
+	worldBounds = localBounds.transformed(matrix);
+	worldSphere = localSphere.transformed(matrix);
 
 	matrixDirty = false;
 }
 
-std::vector<VertexData*> Mesh::getTriangleData(int index)
+void Mesh::computeBounds()
 {
-	std::vector<VertexData*> output{};
-	output.reserve(3);
-
-	for (int i = 0; i < 3; i++)
-		/* The reason modulo is used is because it makes it possible to give fewer VertexData objects than there are vertices
-		 * In that case, it wraps around for vertex indices that are >= vertexData.size()
-		 * It's mostly for experimentation, as this would NEVER happen in a real use case, but it doesn't cost anything to
-		 * leave it here for future tests!
-		 */
-		output.push_back(vertexData[(index + i) % vertexData.size()]);
-
-	return output;
+	localBounds = {};
+	for (const auto& vert : verts)
+		localBounds.extend(vert);
+
+	// Centered on the box, which is close enough to the smallest sphere for culling
+	localSphere = { localBounds.isEmpty() ? glm::vec3{} : localBounds.getCenter(), 0 };
+	for (const auto& vert : verts)
+		localSphere.radius = std::max(localSphere.radius, glm::length(vert - localSphere.center));
 }
 
 glm::vec3& Mesh::getPosition()
@@ -104,26 +128,57 @@ void Mesh::setPosition(glm::vec3 pos)
 {
 	position = pos;
 	matrixDirty = true;
+	transformVersion++;
 }
 
 void Mesh::setScale(glm::vec3 scl)
 {
 	scale = scl;
 	matrixDirty = true;
+	transformVersion++;
 }
 
 void Mesh::setRotation(glm::vec3 rot)
 {
 	rotation = rot;
 	matrixDirty = true;
+	transformVersion++;
 }
 
-/**
- * \brief Release all of the vertex data memory
- */
-Mesh::~Mesh()
+size_t Mesh::getVertexCount() const
 {
-	for (int i = 0; i < vertexData.size(); i++)
-		delete vertexData[i];
+	return verts.size();
 }
 
+size_t Mesh::getTriangleCount() const
+{
+	return indices.size() / 3;
+}
+
+const glm::mat4& Mesh::getMatrix()
+{
+	updateMatrix();
+	return matrix;
+}
+
+const BoundingBox& Mesh::getLocalBounds() const
+{
+	return localBounds;
+}
+
+const BoundingBox& Mesh::getWorldBounds()
+{
+	updateMatrix();
+	return worldBounds;
+}
+
+const BoundingSphere& Mesh::getWorldSphere()
+{
+	updateMatrix();
+	return worldSphere;
+}
+
+unsigned Mesh::getTransformVersion() const
+{
+	return transformVersion;
+}
@@ -2,6 +2,8 @@
 #include <vector>
 #include <glm/vec3.hpp>
 
+#include "Bounds.h"
+#include "CommandBuffer.h"
 #include "Renderer.h"
 #include "VertexData.h"
 
@@ -14,23 +16,53 @@ public:
 	/**
 	 * \brief Initialize this mesh
 	 * \param vertices the vertices composing the mesh, interpreted as triangles
-	 * \param vertexData the data bound to the vertices. If this vector has fewer elements than vertices, the data is repeated
-	 * by wrapping around the vector for vertices that exceed it's size
-	 * the data bound to the three vertices of composing the requested triangle, as a vector of three VertexData objects
+	 * \param vertexData the data bound to the vertices. If it has fewer elements than vertices, the data is repeated
+	 * by wrapping around its attributes for vertices that exceed it's size
+	 * Vertices sharing the same position and data are merged, so that they are only processed once per draw
 	 */
-	Mesh(std::vector<glm::vec3> vertices, std::vector<VertexData*>&& vertexData);
-	Mesh(const Mesh& other) = default;
-
-	Mesh& operator= (const Mesh& other) = default;
-
-	Mesh(Mesh&& other);
-	Mesh& operator= (Mesh&& other);
+	Mesh(std::vector<glm::vec3> vertices, const VertexData& vertexData);
+	/**
+	 * \brief Initialize this mesh from unique vertices
+	 * \param vertices the unique vertices of the mesh
+	 * \param indices the indices of the vertices, interpreted as triangles
+	 * \param vertexData the data bound to the vertices, one element of each attribute for every vertex
+	 */
+	Mesh(std::vector<glm::vec3> vertices, std::vector<unsigned> indices, VertexData vertexData);
 
 	/**
 	 * \brief Draw the mesh on the screen
 	 * \param renderer the used renderer
 	 */
 	void render(Renderer& renderer);
+	/**
+	 * \brief Draw the mesh on the screen with the given shader, using the rendering path specialized for ShaderT
+	 * \param renderer the used renderer
+	 * \param shader the used shader
+	 */
+	template <class ShaderT>
+	void render(Renderer& renderer, ShaderT& shader);
+	/**
+	 * \brief Records the draw of the mesh with the given shader, the mesh must not be destroyed before the commands are
+	 * executed
+	 * \param commands the buffer recording the frame
+	 * \param shader the used shader, copied by the buffer
+	 */
+	template <class ShaderT>
+	void render(CommandBuffer& commands, ShaderT& shader);
+	/**
+	 * \brief Draws several copies of the mesh at once, sharing its vertices. The position, scale and rotation of the
+	 * mesh are ignored, each instance has its own transform
+	 * \param renderer the used renderer
+	 * \param shader the used shader
+	 * \param instances the transform and color of each copy
+	 */
+	template <class ShaderT>
+	void renderInstanced(Renderer& renderer, ShaderT& shader, const std::vector<InstanceUniforms>& instances);
+	/**
+	 * \brief Draws only the depth of the mesh, for instance into a shadow map
+	 * \param viewProjection the matrix going from world space to clip space
+	 */
+	void renderDepth(Renderer& renderer, const glm::mat4& viewProjection);
 
 	void setPosition(glm::vec3 pos);
 	void setScale(glm::vec3 scl);
@@ -40,13 +72,45 @@ public:
 	glm::vec3& getScale();
 	glm::vec3& getRotation();
 
-	~Mesh();
+	/**
+	 * \return the number of unique vertices, each of them is processed once per draw by the vertex shader
+	 */
+	size_t getVertexCount() const;
+	size_t getTriangleCount() const;
+
+	/**
+	 * \return the transform made of the position, scale and rotation of the mesh, for instance to place the instances of
+	 * an instanced draw the same way
+	 */
+	const glm::mat4& getMatrix();
+
+	/**
+	 * \return the box containing the vertices of the mesh, in object space
+	 */
+	const BoundingBox& getLocalBounds() const;
+	/**
+	 * \return the box containing the mesh, in world space. Recomputed only along with the transform
+	 */
+	const BoundingBox& getWorldBounds();
+	/**
+	 * \return the sphere containing the mesh, in world space. Recomputed only along with the transform
+	 */
+	const BoundingSphere& getWorldSphere();
+	/**
+	 * \return a number incremented by every call to setPosition(), setScale() and setRotation(), so that the bounding
+	 * volume hierarchies tell which meshes have moved since they last looked at them
+	 */
+	unsigned getTransformVersion() const;
+
 private:
-	// Vertex data of the mesh
+	// Vertex data of the mesh, every vertex is unique
 	std::vector<glm::vec3> verts;
 
 	// The data bound to the mesh' vertices
-	std::vector<VertexData*> vertexData;
+	VertexData vertexData;
+
+	// Every three indices in verts form a triangle
+	std::vector<unsigned> indices;
 
 	glm::vec3 position{};
 	glm::vec3 scale{};
@@ -54,15 +118,52 @@ private:
 
 	bool matrixDirty;
 	glm::mat4 matrix{};
+	// Used by the shaders to transform the normals, recomputed only along with matrix
+	glm::mat4 normalMatrix{};
+	unsigned transformVersion{ 0 };
+
+	// Computed once from the vertices, when the mesh is created
+	BoundingBox localBounds;
+	BoundingSphere localSphere;
+	// The local bounds transformed by matrix, recomputed along with it
+	BoundingBox worldBounds;
+	BoundingSphere worldSphere;
 
 	/**
-	 * \brief When matrixDirty is set to true, compute the transform matrix and set matrixDirty to false
+	 * \brief When matrixDirty is set to true, compute the transform and normal matrices and the world bounds, and set
+	 * matrixDirty to false
 	 */
 	void updateMatrix();
-
 	/**
-	 * \param firstVertIndex the index of the first vertex of the triangle (i.e. index % 3 == 0)
-	 * \return the data of the vertices composing the triangle whose first vertex has the given index
+	 * \brief Computes the local bounds from the vertices
 	 */
-	 std::vector<VertexData*> getTriangleData(int firstVertIndex);
+	void computeBounds();
 };
+
+template <class ShaderT>
+void Mesh::render(Renderer& renderer, ShaderT& shader)
+{
+	updateMatrix();
+
+	// Set the global transform used by the shader
+	shader.setDrawUniforms({ matrix, normalMatrix });
+
+	// Pass the vertices, their data and the triangles to the renderer
+	renderer.drawIndexed(shader, verts, vertexData, indices);
+}
+
+template <class ShaderT>
+void Mesh::render(CommandBuffer& commands, ShaderT& shader)
+{
+	updateMatrix();
+
+	shader.setDrawUniforms({ matrix, normalMatrix });
+
+	commands.drawIndexed(shader, verts, vertexData, indices);
+}
+
+template <class ShaderT>
+void Mesh::renderInstanced(Renderer& renderer, ShaderT& shader, const std::vector<InstanceUniforms>& instances)
+{
+	renderer.drawInstanced(shader, verts, vertexData, indices, instances);
+}
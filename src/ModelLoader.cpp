@@ -0,0 +1,285 @@
+﻿#include "ModelLoader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <assimp/cimport.h>
+#include <assimp/material.h>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+namespace
+{
+	constexpr char MAGIC[4] = { 'B', 'G', 'L', 'M' };
+
+	// The cache stores the arrays as they are in memory
+	static_assert(sizeof(glm::vec2) == 2 * sizeof(float) && sizeof(glm::vec3) == 3 * sizeof(float),
+	              "glm vectors must not be padded");
+	static_assert(sizeof(ofColor) == 4, "ofColor must be 4 bytes");
+	static_assert(sizeof(unsigned) == 4, "The indices must be 32 bits");
+
+	/**
+	 * \brief Gets the size and the last modification time of a file
+	 * \return false if the file doesn't exist
+	 */
+	bool getFileInfo(const std::string& path, uint64_t& size, int64_t& time)
+	{
+#ifdef _WIN32
+		struct _stat64 info;
+		if (_stat64(path.c_str(), &info) != 0) return false;
+#else
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0) return false;
+#endif
+
+		size = static_cast<uint64_t>(info.st_size);
+		time = static_cast<int64_t>(info.st_mtime);
+		return true;
+	}
+
+	uint32_t packColor(ofColor color)
+	{
+		return color.r | color.g << 8 | color.b << 16 | static_cast<uint32_t>(color.a) << 24;
+	}
+
+	ofColor toColor(const aiColor4D& color)
+	{
+		const auto channel = [](float value)
+		{
+			return std::round(std::min(std::max(value, 0.0f), 1.0f) * 255);
+		};
+		return ofColor(channel(color.r), channel(color.g), channel(color.b), channel(color.a));
+	}
+
+	/**
+	 * \brief Imports a model file into the arrays of a mesh, see importModel()
+	 */
+	void importArrays(const std::string& path, ofColor color, std::vector<glm::vec3>& vertices,
+	                  std::vector<unsigned>& indices, VertexData& data)
+	{
+		/* The same importer as ofxAssimpModelLoader, without the GL resources it creates along with the model: the mesh is
+		 * drawn by the renderer, and may be loaded without a window. Flattening the nodes bakes their transforms into the
+		 * vertices, and sorting by primitive type leaves the points and lines in meshes of their own, skipped below
+		 */
+		const unsigned flags = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals |
+		                       aiProcess_PreTransformVertices | aiProcess_SortByPType;
+		const aiScene* scene = aiImportFile(path.c_str(), flags);
+		if (scene == nullptr)
+		{
+			std::cerr << "Error, couldn't import " << path << ": " << aiGetErrorString() << std::endl;
+			throw std::bad_function_call();
+		}
+
+		// The texture coordinates are kept if any of the meshes has some, the others get zeros
+		bool textured = false;
+		for (unsigned i = 0; i < scene->mNumMeshes; i++)
+		{
+			const aiMesh& mesh = *scene->mMeshes[i];
+			if (mesh.mPrimitiveTypes != aiPrimitiveType_TRIANGLE) continue;
+
+			// The color of the vertices without one, from the material when it has one
+			ofColor meshColor{ 255, 255 };
+			aiColor4D diffuse;
+			if (aiGetMaterialColor(scene->mMaterials[mesh.mMaterialIndex], AI_MATKEY_COLOR_DIFFUSE, &diffuse) == AI_SUCCESS)
+				meshColor = toColor(diffuse);
+
+			const unsigned first = static_cast<unsigned>(vertices.size());
+			vertices.reserve(first + mesh.mNumVertices);
+			data.reserve(first + mesh.mNumVertices);
+			for (unsigned v = 0; v < mesh.mNumVertices; v++)
+			{
+				const aiVector3D& position = mesh.mVertices[v];
+				vertices.emplace_back(position.x, position.y, position.z);
+
+				const aiVector3D normal = mesh.HasNormals() ? mesh.mNormals[v] : aiVector3D{ 0, 0, 1 };
+				data.normals.emplace_back(normal.x, normal.y, normal.z);
+				data.colors.push_back((mesh.HasVertexColors(0) ? toColor(mesh.mColors[0][v]) : meshColor) * color);
+
+				const aiVector3D uv = mesh.HasTextureCoords(0) ? mesh.mTextureCoords[0][v] : aiVector3D{ 0, 0, 0 };
+				data.uvs.emplace_back(uv.x, uv.y);
+			}
+			textured |= mesh.HasTextureCoords(0);
+
+			for (unsigned f = 0; f < mesh.mNumFaces; f++)
+			{
+				const aiFace& face = mesh.mFaces[f];
+				for (unsigned j = 0; j < face.mNumIndices; j++)
+					indices.push_back(first + face.mIndices[j]);
+			}
+		}
+
+		aiReleaseImport(scene);
+
+		if (!textured) data.uvs.clear();
+	}
+}
+
+Mesh importModel(const std::string& path, ofColor color)
+{
+	std::vector<glm::vec3> vertices;
+	std::vector<unsigned> indices;
+	VertexData data;
+	importArrays(path, color, vertices, indices, data);
+
+	return { std::move(vertices), std::move(indices), std::move(data) };
+}
+
+Mesh loadModel(const std::string& path, ofColor color)
+{
+	const std::string cachePath = ModelCache::getPath(path);
+
+	ModelCache cache;
+	if (cache.open(cachePath, path, color))
+		return cache.toMesh();
+
+	std::vector<glm::vec3> vertices;
+	std::vector<unsigned> indices;
+	VertexData data;
+	importArrays(path, color, vertices, indices, data);
+
+	// The mesh is usable without its cache, it is simply imported again next time
+	if (!ModelCache::write(cachePath, path, color, vertices, indices, data))
+		std::cerr << "Error, couldn't write " << cachePath << std::endl;
+
+	return { std::move(vertices), std::move(indices), std::move(data) };
+}
+
+std::string ModelCache::getPath(const std::string& modelPath)
+{
+	return modelPath + ".bglm";
+}
+
+bool ModelCache::write(const std::string& cachePath, const std::string& modelPath, ofColor color,
+                       const std::vector<glm::vec3>& vertices, const std::vector<unsigned>& indices,
+                       const VertexData& data)
+{
+	Header header{};
+	std::copy_n(MAGIC, 4, header.magic);
+	header.version = VERSION;
+	header.vertexCount = static_cast<uint32_t>(vertices.size());
+	header.indexCount = static_cast<uint32_t>(indices.size());
+	header.color = packColor(color);
+	if (!getFileInfo(modelPath, header.modelSize, header.modelTime)) return false;
+
+	header.textured = !data.uvs.empty();
+	if (data.normals.size() < vertices.size() || data.colors.size() < vertices.size() ||
+	    (header.textured && data.uvs.size() < vertices.size()))
+		return false;
+
+	std::ofstream stream{ cachePath, std::ios::binary };
+	if (!stream) return false;
+
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	stream.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(glm::vec3));
+	stream.write(reinterpret_cast<const char*>(data.normals.data()), vertices.size() * sizeof(glm::vec3));
+	stream.write(reinterpret_cast<const char*>(data.colors.data()), vertices.size() * sizeof(ofColor));
+	if (header.textured)
+		stream.write(reinterpret_cast<const char*>(data.uvs.data()), vertices.size() * sizeof(glm::vec2));
+	stream.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(unsigned));
+
+	return static_cast<bool>(stream);
+}
+
+bool ModelCache::open(const std::string& cachePath, const std::string& modelPath, ofColor color)
+{
+	close();
+
+	uint64_t modelSize;
+	int64_t modelTime;
+	if (!getFileInfo(modelPath, modelSize, modelTime) || !file.open(cachePath)) return false;
+
+	// Reject anything that wasn't written by write() for this very model, rather than reading past the mapping
+	const auto* mapped = reinterpret_cast<const Header*>(file.getData());
+	const bool valid = file.getSize() >= sizeof(Header) && std::equal(MAGIC, MAGIC + 4, mapped->magic) &&
+	                   mapped->version == VERSION && mapped->modelSize == modelSize && mapped->modelTime == modelTime &&
+	                   mapped->color == packColor(color) && mapped->textured <= 1 && mapped->indexCount % 3 == 0;
+	const size_t vertexSize =
+	    2 * sizeof(glm::vec3) + sizeof(ofColor) + (valid && mapped->textured ? sizeof(glm::vec2) : 0);
+	if (!valid ||
+	    file.getSize() != sizeof(Header) + mapped->vertexCount * vertexSize + mapped->indexCount * sizeof(unsigned))
+	{
+		close();
+		return false;
+	}
+
+	header = mapped;
+
+	// A single pass over the indices, much cheaper than importing the model, keeps a damaged cache from being drawn
+	const unsigned vertexCount = header->vertexCount;
+	const unsigned* indices = getIndices();
+	if (std::any_of(indices, indices + header->indexCount, [vertexCount](unsigned index) { return index >= vertexCount; }))
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void ModelCache::close()
+{
+	file.close();
+	header = nullptr;
+}
+
+size_t ModelCache::getVertexCount() const
+{
+	return header ? header->vertexCount : 0;
+}
+
+size_t ModelCache::getIndexCount() const
+{
+	return header ? header->indexCount : 0;
+}
+
+const glm::vec3* ModelCache::getVertices() const
+{
+	return header ? reinterpret_cast<const glm::vec3*>(header + 1) : nullptr;
+}
+
+const glm::vec3* ModelCache::getNormals() const
+{
+	return header ? getVertices() + header->vertexCount : nullptr;
+}
+
+const ofColor* ModelCache::getColors() const
+{
+	return header ? reinterpret_cast<const ofColor*>(getNormals() + header->vertexCount) : nullptr;
+}
+
+const glm::vec2* ModelCache::getUvs() const
+{
+	return header && header->textured ? reinterpret_cast<const glm::vec2*>(getColors() + header->vertexCount) : nullptr;
+}
+
+const unsigned* ModelCache::getIndices() const
+{
+	if (header == nullptr) return nullptr;
+
+	const void* end = header->textured ? static_cast<const void*>(getUvs() + header->vertexCount) :
+	                                     static_cast<const void*>(getColors() + header->vertexCount);
+	return static_cast<const unsigned*>(end);
+}
+
+Mesh ModelCache::toMesh() const
+{
+	const size_t vertexCount = getVertexCount();
+
+	VertexData data;
+	data.normals.assign(getNormals(), getNormals() + vertexCount);
+	data.colors.assign(getColors(), getColors() + vertexCount);
+	if (getUvs() != nullptr)
+		data.uvs.assign(getUvs(), getUvs() + vertexCount);
+
+	return {
+		std::vector<glm::vec3>(getVertices(), getVertices() + vertexCount),
+		std::vector<unsigned>(getIndices(), getIndices() + getIndexCount()),
+		std::move(data)
+	};
+}
@@ -0,0 +1,100 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "VertexData.h"
+
+/**
+ * \brief Imports every triangle of a model file (OBJ, FBX, glTF, PLY, ... anything Assimp reads) into a single mesh.
+ * The nodes of the model are flattened with their transforms, identical vertices are merged, and the normals are
+ * generated when the file has none. The texture coordinates of the first channel are kept, if the model has some.
+ * Slow for large files, prefer loadModel() to import a model more than once
+ * \param path the model file
+ * \param color multiplies the colors of the vertices, which come from the vertex colors of the model, or else from the
+ * diffuse color of their material, or else are white
+ * \return the mesh, in the units and at the position of the model file
+ */
+Mesh importModel(const std::string& path, ofColor color = { 255, 255 });
+
+/**
+ * \brief Same as importModel(), through a cache file next to the model: the cache is mapped if it is up to date,
+ * otherwise the model is imported and the cache is written for the next runs
+ */
+Mesh loadModel(const std::string& path, ofColor color = { 255, 255 });
+
+/**
+ * \brief A mesh stored in a binary file that is mapped in memory, so that its vertices and indices are used as they
+ * are instead of being parsed. The file is a header followed by the positions, the normals, the colors, the texture
+ * coordinates if the model has some, and the indices, each packed in an array, in the byte order of the machine that
+ * wrote it
+ */
+class ModelCache
+{
+public:
+	// Incremented whenever the layout of the file changes, making the caches written before it out of date
+	static constexpr uint32_t VERSION = 2;
+
+	/**
+	 * \return the path of the cache of a model file
+	 */
+	static std::string getPath(const std::string& modelPath);
+
+	/**
+	 * \brief Writes the cache of a model
+	 * \param modelPath the model file, whose size and modification time are stored to tell when the cache is out of date
+	 * \param color the color given to importModel(), a cache imported with another color is out of date too
+	 * \return false if the file couldn't be written
+	 */
+	static bool write(const std::string& cachePath, const std::string& modelPath, ofColor color,
+	                  const std::vector<glm::vec3>& vertices, const std::vector<unsigned>& indices,
+	                  const VertexData& data);
+
+	/**
+	 * \brief Maps the cache of a model
+	 * \return false if the cache is missing, invalid, or older than the model
+	 */
+	bool open(const std::string& cachePath, const std::string& modelPath, ofColor color);
+	void close();
+
+	// The arrays of the cache, valid until it is closed
+	size_t getVertexCount() const;
+	size_t getIndexCount() const;
+	const glm::vec3* getVertices() const;
+	const glm::vec3* getNormals() const;
+	const ofColor* getColors() const;
+	// nullptr if the model has no texture coordinates
+	const glm::vec2* getUvs() const;
+	const unsigned* getIndices() const;
+
+	/**
+	 * \brief Copies the arrays of the cache into a mesh, the cache can be closed afterwards
+	 */
+	Mesh toMesh() const;
+
+private:
+	/**
+	 * \brief The start of the file
+	 */
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		// The size and modification time of the model file when the cache was written
+		uint64_t modelSize;
+		int64_t modelTime;
+		// The color given to importModel(), packed as RGBA
+		uint32_t color;
+		// 1 if the texture coordinates are stored, 0 otherwise
+		uint32_t textured;
+	};
+
+	MappedFile file;
+	const Header* header{ nullptr };
+};
@@ -4,9 +4,18 @@ OutlineShader::OutlineShader(const glm::mat4& persp, bool lit, ofColor outlineCo
 	outline{outlineColor}
 {}
 
-void OutlineShader::setUniform1fv(std::string name, float value)
+UniformLocation OutlineShader::getUniformLocation(const std::string& name) const
 {
-	if (name == "sinTime") {
+	if (name == "sinTime") return SIN_TIME;
+	if (name == "minThickness") return MIN_THICKNESS;
+	if (name == "maxThickness") return MAX_THICKNESS;
+
+	return SimpleShader::getUniformLocation(name);
+}
+
+void OutlineShader::setUniform1fv(UniformLocation location, float value)
+{
+	if (location == SIN_TIME) {
 		sinTime = value;
 
 		const float normalized = (value + 1) / 2;
@@ -14,20 +23,22 @@ void OutlineShader::setUniform1fv(std::string name, float value)
 		const float delta = maxThickness - minThickness;
 		usedThickness = minThickness + delta * normalized;
 	}
-	else if (name == "minThickness")
+	else if (location == MIN_THICKNESS)
 		minThickness = value;
-	else if (name == "maxThickness")
+	else if (location == MAX_THICKNESS)
 		maxThickness = value;
+	else
+		SimpleShader::setUniform1fv(location, value);
 }
 
-ofColor OutlineShader::getColor(glm::vec3 barycentric, PosVertexData** enclosingVerts)
+ofColor OutlineShader::getColor(const glm::vec3& barycentric, const TriangleContext& triangle)
 {
-	// return SimpleShader::getColor(barycentric, enclosingVerts);
+	// return SimpleShader::getColor(barycentric, triangle);
 
 	glm::vec3 localPos{0};
 
 	for (int i = 0; i < 3; i++)
-		localPos += enclosingVerts[i]->localPos * barycentric[i];
+		localPos += triangle.localPos[i] * barycentric[i];
 
 	int matchCounter = 0;
 
@@ -40,5 +51,5 @@ ofColor OutlineShader::getColor(glm::vec3 barycentric, PosVertexData** enclosing
 	}
 
 	// Rollback to default behaviour if the fragment is not inside the outline
-	return SimpleShader::getColor(barycentric, enclosingVerts);
+	return SimpleShader::getColor(barycentric, triangle);
 }
@@ -4,10 +4,38 @@
 class OutlineShader: public SimpleShader
 {
 public:
+	enum : UniformLocation
+	{
+		SIN_TIME = SimpleShader::UNIFORM_COUNT,
+		MIN_THICKNESS,
+		MAX_THICKNESS,
+		UNIFORM_COUNT
+	};
+
 	OutlineShader(const glm::mat4& persp, bool lit, ofColor outlineColor);
 
-	void setUniform1fv(std::string name, float value) override;
-	ofColor getColor(glm::vec3 barycentric, PosVertexData** enclosingVerts) override;
+	UniformLocation getUniformLocation(const std::string& name) const override;
+
+	using SimpleShader::setUniform1fv;
+	void setUniform1fv(UniformLocation location, float value) override;
+
+	ofColor runFragmentShader(const glm::vec3& barycentric, const TriangleContext& triangle) override
+	{
+		return shadeFragment(barycentric, triangle, [this](const glm::vec3& b, const TriangleContext& t)
+		{
+			return OutlineShader::getColor(b, t);
+		});
+	}
+	void runFragmentBatch(const FragmentBatch& fragments, const TriangleContext& triangle, SimdLevel simd,
+	                      ofColor* colors) override
+	{
+		shadeFragments(fragments, triangle, simd, colors, [this](const glm::vec3& b, const TriangleContext& t)
+		{
+			return OutlineShader::getColor(b, t);
+		});
+	}
+
+	ofColor getColor(const glm::vec3& barycentric, const TriangleContext& triangle) override;
 
 private:
 	ofColor outline;
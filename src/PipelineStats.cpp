@@ -0,0 +1,130 @@
+﻿#include "PipelineStats.h"
+
+#include <fstream>
+
+void PipelineCounters::add(const PipelineCounters& other)
+{
+	trianglesIn += other.trianglesIn;
+	trianglesOutsideFrustum += other.trianglesOutsideFrustum;
+	trianglesClipped += other.trianglesClipped;
+	trianglesCulled += other.trianglesCulled;
+	trianglesHidden += other.trianglesHidden;
+	trianglesQueued += other.trianglesQueued;
+
+	blocksHidden += other.blocksHidden;
+	pixelsTested += other.pixelsTested;
+	pixelsCovered += other.pixelsCovered;
+	depthPassed += other.depthPassed;
+	depthFailed += other.depthFailed;
+	fragmentsShaded += other.fragmentsShaded;
+
+	vertexSeconds += other.vertexSeconds;
+	assemblySeconds += other.assemblySeconds;
+	rasterSeconds += other.rasterSeconds;
+	shadingSeconds += other.shadingSeconds;
+	threadSeconds += other.threadSeconds;
+}
+
+void PipelineCounters::print(std::ostream& out) const
+{
+	out << "triangles in:           " << trianglesIn << "\n"
+		<< "  outside the frustum:  " << trianglesOutsideFrustum << "\n"
+		<< "  clipped:              " << trianglesClipped << "\n"
+		<< "  culled:               " << trianglesCulled << "\n"
+		<< "  hidden:               " << trianglesHidden << "\n"
+		<< "  queued:               " << trianglesQueued << "\n"
+		<< "blocks hidden:          " << blocksHidden << "\n"
+		<< "pixels tested:          " << pixelsTested << "\n"
+		<< "pixels covered:         " << pixelsCovered << "\n"
+		<< "depth test passed:      " << depthPassed << "\n"
+		<< "depth test failed:      " << depthFailed << "\n"
+		<< "fragments shaded:       " << fragmentsShaded << "\n"
+		<< "vertex stage:           " << vertexSeconds * 1000 << " ms\n"
+		<< "primitive assembly:     " << assemblySeconds * 1000 << " ms\n"
+		<< "rasterization:          " << rasterSeconds * 1000 << " ms\n"
+		<< "deferred shading:       " << shadingSeconds * 1000 << " ms\n"
+		<< "busy threads:           " << threadSeconds * 1000 << " ms\n";
+}
+
+TraceRecorder::TraceRecorder() : origin{ Clock::now() }
+{
+}
+
+void TraceRecorder::setEnabled(bool value)
+{
+	enabled = value;
+}
+
+bool TraceRecorder::isEnabled() const
+{
+	return enabled;
+}
+
+void TraceRecorder::record(const char* name, Clock::time_point start, Clock::time_point end)
+{
+	if (!enabled) return;
+
+	std::lock_guard<std::mutex> lock{ mutex };
+	events.push_back({ name, toMicroseconds(start), toMicroseconds(end) - toMicroseconds(start),
+	                   getThreadIndex(std::this_thread::get_id()), false, 0 });
+}
+
+void TraceRecorder::recordCounters(const PipelineCounters& counters, Clock::time_point time)
+{
+	if (!enabled) return;
+
+	std::lock_guard<std::mutex> lock{ mutex };
+	const double start = toMicroseconds(time);
+	const int thread = getThreadIndex(std::this_thread::get_id());
+
+	events.push_back({ "triangles queued", start, 0, thread, true, static_cast<double>(counters.trianglesQueued) });
+	events.push_back({ "pixels tested", start, 0, thread, true, static_cast<double>(counters.pixelsTested) });
+	events.push_back({ "fragments shaded", start, 0, thread, true, static_cast<double>(counters.fragmentsShaded) });
+}
+
+bool TraceRecorder::write(const std::string& path) const
+{
+	std::ofstream file{ path };
+	if (!file) return false;
+
+	std::lock_guard<std::mutex> lock{ mutex };
+
+	file << "{\"traceEvents\":[\n";
+	for (size_t i = 0; i < events.size(); i++)
+	{
+		const Event& event = events[i];
+		file << "{\"name\":\"" << event.name << "\",\"pid\":0,\"tid\":" << event.thread << ",\"ts\":" << event.start;
+
+		if (event.counter)
+			file << ",\"ph\":\"C\",\"args\":{\"value\":" << event.value << "}}";
+		else
+			file << ",\"ph\":\"X\",\"dur\":" << event.duration << "}";
+
+		file << (i + 1 < events.size() ? ",\n" : "\n");
+	}
+	file << "]}\n";
+
+	return static_cast<bool>(file);
+}
+
+void TraceRecorder::clear()
+{
+	std::lock_guard<std::mutex> lock{ mutex };
+	events.clear();
+}
+
+double TraceRecorder::toMicroseconds(Clock::time_point time) const
+{
+	return std::chrono::duration<double, std::micro>(time - origin).count();
+}
+
+int TraceRecorder::getThreadIndex(std::thread::id thread)
+{
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		if (threads[i] == thread) return static_cast<int>(i);
+	}
+
+	threads.push_back(thread);
+	return static_cast<int>(threads.size()) - 1;
+}
@@ -0,0 +1,170 @@
+﻿#pragma once
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Set to 0 to compile out every counter and timer of the pipeline
+#ifndef FAKEGL_STATS
+#define FAKEGL_STATS 1
+#endif
+
+// Runs the given statement only when the statistics are compiled in
+#if FAKEGL_STATS
+#define FAKEGL_STAT(statement) statement
+#else
+#define FAKEGL_STAT(statement)
+#endif
+
+/**
+ * \brief What went through each stage of the pipeline, and how long each stage took. Rasterization threads count in
+ * their own copy, which is added to the renderer's one once per tile
+ */
+struct PipelineCounters
+{
+	// Triangles entering primitive assembly
+	uint64_t trianglesIn{};
+	// Triangles entirely outside of one of the planes of the view frustum
+	uint64_t trianglesOutsideFrustum{};
+	// Triangles crossing the near plane, each of them is split in one or two triangles
+	uint64_t trianglesClipped{};
+	// Triangles discarded after clipping: culled by their winding, covering no pixel or outside of the guard band
+	uint64_t trianglesCulled{};
+	// Triangles behind the depth buffer in every tile they overlap
+	uint64_t trianglesHidden{};
+	// Triangles queued for rasterization
+	uint64_t trianglesQueued{};
+
+	// Depth buffer blocks skipped because the triangle was behind them
+	uint64_t blocksHidden{};
+	// Pixels of the bounding boxes tested against the edges of the triangles
+	uint64_t pixelsTested{};
+	uint64_t pixelsCovered{};
+	uint64_t depthPassed{};
+	uint64_t depthFailed{};
+	// Fragment shader invocations
+	uint64_t fragmentsShaded{};
+
+	// Time spent in each stage, in seconds. In forward mode, shading happens while rasterizing and is part of
+	// rasterSeconds; in deferred mode it is measured separately by resolve()
+	double vertexSeconds{};
+	double assemblySeconds{};
+	double rasterSeconds{};
+	double shadingSeconds{};
+	// The time the threads spent on the jobs of the stages, summed over all of the threads
+	double threadSeconds{};
+
+	/**
+	 * \brief Adds the counters and times of other to this one
+	 */
+	void add(const PipelineCounters& other);
+
+	/**
+	 * \brief Writes every counter and time, one per line
+	 */
+	void print(std::ostream& out) const;
+};
+
+/**
+ * \return the number of bits set, for the masks of a few pixels used by the rasterizer
+ */
+inline int countBits(unsigned bits)
+{
+	int count = 0;
+	for (; bits != 0; bits &= bits - 1)
+		count++;
+	return count;
+}
+
+/**
+ * \brief Records the stages of the pipeline as a timeline, which can be saved in the Chrome trace format and opened
+ * with chrome://tracing or Perfetto. Thread safe
+ */
+class TraceRecorder
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	TraceRecorder();
+
+	/**
+	 * \brief Starts or stops recording, nothing is recorded by default
+	 */
+	void setEnabled(bool enabled);
+	bool isEnabled() const;
+
+	/**
+	 * \brief Records an event of the calling thread, if recording
+	 * \param name the name of the event, must be a string literal
+	 */
+	void record(const char* name, Clock::time_point start, Clock::time_point end);
+	/**
+	 * \brief Records the counters of a frame as counter events, if recording
+	 */
+	void recordCounters(const PipelineCounters& counters, Clock::time_point time);
+
+	/**
+	 * \brief Writes the recorded events as a Chrome trace JSON file
+	 * \return false if the file couldn't be written
+	 */
+	bool write(const std::string& path) const;
+	void clear();
+
+private:
+	struct Event
+	{
+		const char* name;
+		// Relative to origin, in microseconds
+		double start;
+		double duration;
+		int thread;
+		// Counter events have a value but no duration
+		bool counter;
+		double value;
+	};
+
+	bool enabled{ false };
+	Clock::time_point origin;
+	mutable std::mutex mutex;
+	std::vector<Event> events;
+	// Threads are numbered in the order they record their first event
+	std::vector<std::thread::id> threads;
+
+	double toMicroseconds(Clock::time_point time) const;
+	int getThreadIndex(std::thread::id thread);
+};
+
+/**
+ * \brief Measures the time from its construction to its destruction, adds it to a total and records it as a trace
+ * event
+ */
+class StageTimer
+{
+public:
+#if FAKEGL_STATS
+	StageTimer(double& total, TraceRecorder& trace, const char* name) :
+		total(total), trace(trace), name{ name }, start{ TraceRecorder::Clock::now() } {}
+
+	~StageTimer()
+	{
+		const auto end = TraceRecorder::Clock::now();
+		total += std::chrono::duration<double>(end - start).count();
+		trace.record(name, start, end);
+	}
+
+private:
+	double& total;
+	TraceRecorder& trace;
+	const char* name;
+	TraceRecorder::Clock::time_point start;
+#else
+	StageTimer(double&, TraceRecorder&, const char*) {}
+#endif
+
+public:
+	StageTimer(const StageTimer&) = delete;
+	void operator=(const StageTimer&) = delete;
+};
@@ -0,0 +1,25 @@
+﻿#include "Presenter.h"
+
+void Presenter::upload(const RenderTarget& target)
+{
+	if (!texture.isAllocated() || target.getWidth() != width || target.getHeight() != height)
+	{
+		width = target.getWidth();
+		height = target.getHeight();
+		texture.allocate(width, height, GL_RGBA8);
+
+		// This sets the upscaling filter to linear, to avoid blurring when the window's resolution is greater
+		// than the "renderbuffer" resolution
+		texture.setTextureMinMagFilter(GL_LINEAR, GL_NEAREST);
+	}
+
+	// The pixels go straight from the render target to the texture, without any intermediate copy
+	texture.loadData(target.getData(), width, height, GL_RGBA);
+}
+
+void Presenter::draw(float x, float y, float drawWidth, float drawHeight) const
+{
+	if (width == 0) return;
+
+	texture.draw(x, y, drawWidth, drawHeight);
+}
@@ -0,0 +1,27 @@
+﻿#pragma once
+#include "ofImage.h"
+#include "RenderTarget.h"
+
+/**
+ * \brief Shows the frames of a renderer in the window. A single texture is kept for all of the frames, allocated once,
+ * into which the pixels of every frame are uploaded
+ */
+class Presenter
+{
+public:
+	/**
+	 * \brief Uploads the pixels of the target to the texture. The texture is only allocated again when the size of the
+	 * target changes
+	 */
+	void upload(const RenderTarget& target);
+
+	/**
+	 * \brief Draws the last frame uploaded, stretched to the given rectangle of the window
+	 */
+	void draw(float x, float y, float width, float height) const;
+
+private:
+	ofTexture texture;
+	int width{ 0 };
+	int height{ 0 };
+};
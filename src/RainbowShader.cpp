@@ -6,23 +6,31 @@ RainbowShader::RainbowShader(glm::mat4 persp, bool lit)
 	: SimpleShader(persp, lit) {}
 
 
-void RainbowShader::setUniform1fv(std::string name, float value)
+UniformLocation RainbowShader::getUniformLocation(const std::string& name) const
 {
-	SimpleShader::setUniform1fv(name, value);
+	if (name == "time") return TIME;
+	if (name == "frequency") return FREQUENCY;
 
-	if (name == "time")
+	return SimpleShader::getUniformLocation(name);
+}
+
+void RainbowShader::setUniform1fv(UniformLocation location, float value)
+{
+	if (location == TIME)
 		time = value;
-	else if (name == "frequency")
+	else if (location == FREQUENCY)
 		freq = value;
+	else
+		SimpleShader::setUniform1fv(location, value);
 }
 
 
-ofColor RainbowShader::getColor(glm::vec3 barycentric, PosVertexData** enclosingVerts)
+ofColor RainbowShader::getColor(const glm::vec3& barycentric, const TriangleContext& triangle)
 {
 	glm::vec3 fragPos{};
 
 	for (int i = 0; i < 3; i++)
-		fragPos += enclosingVerts[i]->localPos * barycentric[i];
+		fragPos += triangle.localPos[i] * barycentric[i];
 
 	ofColor col{};
 	col.setHsb(remainderf(length(fragPos * freq) + time, 255.0f), 255, 255);
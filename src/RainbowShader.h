@@ -16,11 +16,38 @@
 class RainbowShader : public SimpleShader
 {
 public:
+	enum : UniformLocation
+	{
+		TIME = SimpleShader::UNIFORM_COUNT,
+		FREQUENCY,
+		UNIFORM_COUNT
+	};
+
 	RainbowShader(glm::mat4 persp, bool lit = true);
-	void setUniform1fv(std::string name, float value) override;
+
+	UniformLocation getUniformLocation(const std::string& name) const override;
+
+	using SimpleShader::setUniform1fv;
+	void setUniform1fv(UniformLocation location, float value) override;
+
+	ofColor runFragmentShader(const glm::vec3& barycentric, const TriangleContext& triangle) override
+	{
+		return shadeFragment(barycentric, triangle, [this](const glm::vec3& b, const TriangleContext& t)
+		{
+			return RainbowShader::getColor(b, t);
+		});
+	}
+	void runFragmentBatch(const FragmentBatch& fragments, const TriangleContext& triangle, SimdLevel simd,
+	                      ofColor* colors) override
+	{
+		shadeFragments(fragments, triangle, simd, colors, [this](const glm::vec3& b, const TriangleContext& t)
+		{
+			return RainbowShader::getColor(b, t);
+		});
+	}
 
 protected:
-	ofColor getColor(glm::vec3 barycentric, PosVertexData** enclosingVerts) override;
+	ofColor getColor(const glm::vec3& barycentric, const TriangleContext& triangle) override;
 
 private:
 	float time{};
@@ -0,0 +1,275 @@
+﻿#include "RasterKernels.h"
+
+#include "Renderer.h"
+
+#ifdef FAKEGL_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+SimdLevel detectSimdLevel()
+{
+#ifdef FAKEGL_X86
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	const int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	const bool sse2 = (info[3] & 1 << 26) != 0;
+	// The OS has to save the AVX registers on context switches, otherwise they can't be used
+	const bool osAvx = (info[2] & 1 << 27) != 0 && (info[2] & 1 << 28) != 0 && (_xgetbv(0) & 6) == 6;
+
+	bool avx2 = false;
+	if (maxLeaf >= 7 && osAvx)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & 1 << 5) != 0;
+	}
+
+	if (avx2) return SimdLevel::AVX2;
+	if (sse2) return SimdLevel::SSE2;
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+	if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE2;
+#endif
+#endif
+	return SimdLevel::Scalar;
+}
+
+unsigned ScalarKernel::evaluate(const TriangleSetup& setup, const int64_t* w, const float* depthRow, unsigned inside,
+                                PixelSpan<WIDTH>& span)
+{
+	float base[3];
+	for (int i = 0; i < 3; i++)
+		base[i] = static_cast<float>(w[i]) * setup.invArea;
+
+	unsigned mask = 0;
+	span.covered = 0;
+	for (int k = 0; k < WIDTH; k++)
+	{
+		// When one of the edge functions is < 0, it means that the given point is out of the triangle, skip!
+		const int64_t covered = (w[0] + k * setup.stepX[0] + setup.bias[0]) |
+		                        (w[1] + k * setup.stepX[1] + setup.bias[1]) |
+		                        (w[2] + k * setup.stepX[2] + setup.bias[2]);
+
+		for (int i = 0; i < 3; i++)
+			span.barycentric[i][k] = base[i] + static_cast<float>(k) * setup.baryStepX[i];
+
+		// Obtain the z-value of the fragment by interpolating the z of the vertices
+		span.z[k] = setup.z[0] * span.barycentric[0][k] + setup.z[1] * span.barycentric[1][k] +
+		            setup.z[2] * span.barycentric[2][k];
+
+		if (covered < 0) continue;
+		span.covered |= 1u << k;
+
+		// depth-testing, draw only if the current z is greater than the written one
+		if (depthRow[k] > span.z[k])
+			mask |= 1u << k;
+	}
+
+	span.covered &= inside;
+	return mask & inside;
+}
+
+unsigned ScalarKernel::writeDepth(const TriangleSetup& setup, const int64_t* w, float* depthRow, unsigned inside,
+                                  unsigned& covered)
+{
+	float base[3];
+	for (int i = 0; i < 3; i++)
+		base[i] = static_cast<float>(w[i]) * setup.invArea;
+
+	unsigned mask = 0;
+	covered = 0;
+	for (int k = 0; k < WIDTH; k++)
+	{
+		const int64_t edges = (w[0] + k * setup.stepX[0] + setup.bias[0]) |
+		                      (w[1] + k * setup.stepX[1] + setup.bias[1]) |
+		                      (w[2] + k * setup.stepX[2] + setup.bias[2]);
+		if (edges < 0 || (inside & 1u << k) == 0) continue;
+		covered |= 1u << k;
+
+		// The same operations as evaluate(), so that both write the same depth
+		float barycentric[3];
+		for (int i = 0; i < 3; i++)
+			barycentric[i] = base[i] + static_cast<float>(k) * setup.baryStepX[i];
+		const float z = setup.z[0] * barycentric[0] + setup.z[1] * barycentric[1] + setup.z[2] * barycentric[2];
+
+		if (depthRow[k] > z)
+		{
+			depthRow[k] = z;
+			mask |= 1u << k;
+		}
+	}
+
+	return mask;
+}
+
+#ifdef FAKEGL_X86
+namespace
+{
+	/**
+	 * \return a bit for each of the four pixels starting at w whose edge function is >= 0 for all of the edges
+	 */
+	inline unsigned coverageSse2(const TriangleSetup& setup, const int64_t* w)
+	{
+		// Two int64 per register, the sign bits are gathered with the double movemask
+		__m128i lanes01 = _mm_setzero_si128();
+		__m128i lanes23 = _mm_setzero_si128();
+		for (int i = 0; i < 3; i++)
+		{
+			const int64_t start = w[i] + setup.bias[i];
+			const int64_t step = setup.stepX[i];
+
+			lanes01 = _mm_or_si128(lanes01, _mm_set_epi64x(start + step, start));
+			lanes23 = _mm_or_si128(lanes23, _mm_set_epi64x(start + 3 * step, start + 2 * step));
+		}
+
+		const unsigned negative = _mm_movemask_pd(_mm_castsi128_pd(lanes01)) |
+		                          _mm_movemask_pd(_mm_castsi128_pd(lanes23)) << 2;
+		return ~negative & 0xF;
+	}
+}
+
+unsigned Sse2Kernel::evaluate(const TriangleSetup& setup, const int64_t* w, const float* depthRow, unsigned inside,
+                              PixelSpan<WIDTH>& span)
+{
+	const unsigned covered = coverageSse2(setup, w) & inside;
+	span.covered = covered;
+	if (covered == 0) return 0;
+
+	const __m128 lane = _mm_set_ps(3, 2, 1, 0);
+	__m128 z = _mm_setzero_ps();
+	for (int i = 0; i < 3; i++)
+	{
+		const __m128 base = _mm_set1_ps(static_cast<float>(w[i]) * setup.invArea);
+		const __m128 barycentric = _mm_add_ps(base, _mm_mul_ps(lane, _mm_set1_ps(setup.baryStepX[i])));
+		_mm_storeu_ps(span.barycentric[i], barycentric);
+
+		z = i == 0 ? _mm_mul_ps(_mm_set1_ps(setup.z[0]), barycentric)
+		           : _mm_add_ps(z, _mm_mul_ps(_mm_set1_ps(setup.z[i]), barycentric));
+	}
+	_mm_storeu_ps(span.z, z);
+
+	const unsigned depthPassed = _mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(depthRow), z));
+	return covered & depthPassed;
+}
+
+unsigned Sse2Kernel::writeDepth(const TriangleSetup& setup, const int64_t* w, float* depthRow, unsigned inside,
+                                unsigned& covered)
+{
+	covered = coverageSse2(setup, w) & inside;
+	if (covered == 0) return 0;
+
+	const __m128 lane = _mm_set_ps(3, 2, 1, 0);
+	__m128 z = _mm_setzero_ps();
+	for (int i = 0; i < 3; i++)
+	{
+		const __m128 base = _mm_set1_ps(static_cast<float>(w[i]) * setup.invArea);
+		const __m128 barycentric = _mm_add_ps(base, _mm_mul_ps(lane, _mm_set1_ps(setup.baryStepX[i])));
+
+		z = i == 0 ? _mm_mul_ps(_mm_set1_ps(setup.z[0]), barycentric)
+		           : _mm_add_ps(z, _mm_mul_ps(_mm_set1_ps(setup.z[i]), barycentric));
+	}
+
+	const __m128 depth = _mm_loadu_ps(depthRow);
+	const unsigned passed = covered & _mm_movemask_ps(_mm_cmpgt_ps(depth, z));
+	if (passed == 0) return 0;
+
+	// SSE2 has no masked store, the whole span is written back with the depth of the other pixels unchanged. They are
+	// in the same depth buffer block, so no other thread writes them
+	const __m128i bits = _mm_set_epi32(8, 4, 2, 1);
+	const __m128 write = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(passed), bits), bits));
+	_mm_storeu_ps(depthRow, _mm_or_ps(_mm_and_ps(write, z), _mm_andnot_ps(write, depth)));
+	return passed;
+}
+
+FAKEGL_TARGET_AVX2
+unsigned Avx2Kernel::evaluate(const TriangleSetup& setup, const int64_t* w, const float* depthRow, unsigned inside,
+                              PixelSpan<WIDTH>& span)
+{
+	// Four int64 per register, the span is made of two groups of four pixels
+	__m256i group0 = _mm256_setzero_si256();
+	__m256i group1 = _mm256_setzero_si256();
+	for (int i = 0; i < 3; i++)
+	{
+		const int64_t start = w[i] + setup.bias[i];
+		const int64_t step = setup.stepX[i];
+		const __m256i offsets = _mm256_set_epi64x(3 * step, 2 * step, step, 0);
+
+		group0 = _mm256_or_si256(group0, _mm256_add_epi64(_mm256_set1_epi64x(start), offsets));
+		group1 = _mm256_or_si256(group1, _mm256_add_epi64(_mm256_set1_epi64x(start + 4 * step), offsets));
+	}
+
+	const unsigned negative = _mm256_movemask_pd(_mm256_castsi256_pd(group0)) |
+	                          _mm256_movemask_pd(_mm256_castsi256_pd(group1)) << 4;
+	const unsigned covered = ~negative & 0xFF & inside;
+	span.covered = covered;
+	if (covered == 0) return 0;
+
+	const __m256 lane = _mm256_set_ps(3, 2, 1, 0, 3, 2, 1, 0);
+	__m256 z = _mm256_setzero_ps();
+	for (int i = 0; i < 3; i++)
+	{
+		// Each group starts from the exact value of its first pixel, like the other kernels do
+		const float base0 = static_cast<float>(w[i]) * setup.invArea;
+		const float base1 = static_cast<float>(w[i] + 4 * setup.stepX[i]) * setup.invArea;
+
+		const __m256 base = _mm256_set_ps(base1, base1, base1, base1, base0, base0, base0, base0);
+		const __m256 barycentric = _mm256_add_ps(base, _mm256_mul_ps(lane, _mm256_set1_ps(setup.baryStepX[i])));
+		_mm256_storeu_ps(span.barycentric[i], barycentric);
+
+		z = i == 0 ? _mm256_mul_ps(_mm256_set1_ps(setup.z[0]), barycentric)
+		           : _mm256_add_ps(z, _mm256_mul_ps(_mm256_set1_ps(setup.z[i]), barycentric));
+	}
+	_mm256_storeu_ps(span.z, z);
+
+	const unsigned depthPassed = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(depthRow), z, _CMP_GT_OQ));
+	return covered & depthPassed;
+}
+
+FAKEGL_TARGET_AVX2
+unsigned Avx2Kernel::writeDepth(const TriangleSetup& setup, const int64_t* w, float* depthRow, unsigned inside,
+                                unsigned& covered)
+{
+	__m256i group0 = _mm256_setzero_si256();
+	__m256i group1 = _mm256_setzero_si256();
+	for (int i = 0; i < 3; i++)
+	{
+		const int64_t start = w[i] + setup.bias[i];
+		const int64_t step = setup.stepX[i];
+		const __m256i offsets = _mm256_set_epi64x(3 * step, 2 * step, step, 0);
+
+		group0 = _mm256_or_si256(group0, _mm256_add_epi64(_mm256_set1_epi64x(start), offsets));
+		group1 = _mm256_or_si256(group1, _mm256_add_epi64(_mm256_set1_epi64x(start + 4 * step), offsets));
+	}
+
+	const unsigned negative = _mm256_movemask_pd(_mm256_castsi256_pd(group0)) |
+	                          _mm256_movemask_pd(_mm256_castsi256_pd(group1)) << 4;
+	covered = ~negative & 0xFF & inside;
+	if (covered == 0) return 0;
+
+	const __m256 lane = _mm256_set_ps(3, 2, 1, 0, 3, 2, 1, 0);
+	__m256 z = _mm256_setzero_ps();
+	for (int i = 0; i < 3; i++)
+	{
+		const float base0 = static_cast<float>(w[i]) * setup.invArea;
+		const float base1 = static_cast<float>(w[i] + 4 * setup.stepX[i]) * setup.invArea;
+
+		const __m256 base = _mm256_set_ps(base1, base1, base1, base1, base0, base0, base0, base0);
+		const __m256 barycentric = _mm256_add_ps(base, _mm256_mul_ps(lane, _mm256_set1_ps(setup.baryStepX[i])));
+
+		z = i == 0 ? _mm256_mul_ps(_mm256_set1_ps(setup.z[0]), barycentric)
+		           : _mm256_add_ps(z, _mm256_mul_ps(_mm256_set1_ps(setup.z[i]), barycentric));
+	}
+
+	const unsigned passed = covered & _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(depthRow), z, _CMP_GT_OQ));
+	if (passed == 0) return 0;
+
+	const __m256i bits = _mm256_set_epi32(128, 64, 32, 16, 8, 4, 2, 1);
+	_mm256_maskstore_ps(depthRow, _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(passed), bits), bits), z);
+	return passed;
+}
+#endif
@@ -0,0 +1,108 @@
+﻿#pragma once
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FAKEGL_X86 1
+#include <immintrin.h>
+#endif
+
+// MSVC accepts any intrinsic anywhere, GCC and Clang have to be told which functions may use AVX2
+#if defined(FAKEGL_X86) && (defined(__GNUC__) || defined(__clang__))
+#define FAKEGL_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define FAKEGL_TARGET_AVX2
+#endif
+
+struct TriangleSetup;
+
+/**
+ * \brief The instruction sets the rasterizer can use to process multiple pixels at once
+ */
+enum class SimdLevel
+{
+	Scalar,
+	SSE2,
+	AVX2
+};
+
+/**
+ * \return the best instruction set supported by the CPU running the program
+ */
+SimdLevel detectSimdLevel();
+
+/**
+ * \brief The values computed for a horizontal span of pixels of a triangle, before shading
+ */
+template <int WIDTH>
+struct PixelSpan
+{
+	float barycentric[3][WIDTH];
+	float z[WIDTH];
+	// A bit for every pixel covered by the triangle, whether it passed the depth test or not
+	unsigned covered;
+};
+
+/*
+ * The kernels below test a span of pixels of a row: coverage, barycentric coordinates, depth and depth test.
+ * Depth-only draws go through writeDepth() instead, which computes the depth the same way but keeps nothing else.
+ * Spans are made of groups of 4 pixels, whose first pixel has an x multiple of 4. The barycentric coordinates of a group
+ * are computed from the exact edge values of its first pixel, then stepped for the other three: since every kernel does
+ * exactly the same float operations on each group, all of them produce the same output, bit by bit.
+ */
+
+/**
+ * \brief Processes spans of 4 pixels, one pixel at a time. Used when no SIMD instruction set is available
+ */
+struct ScalarKernel
+{
+	static constexpr int WIDTH = 4;
+
+	/**
+	 * \param setup the triangle
+	 * \param w the values of the three edge functions at the first pixel of the span
+	 * \param depthRow the depth buffer values of the span
+	 * \param inside a bit for every pixel of the span within the area being drawn
+	 * \param span the output
+	 * \return a bit for every pixel of the span covered by the triangle and passing the depth test
+	 */
+	static unsigned evaluate(const TriangleSetup& setup, const int64_t* w, const float* depthRow, unsigned inside,
+	                         PixelSpan<WIDTH>& span);
+	/**
+	 * \brief Same test as evaluate(), for depth-only draws: the depth of the pixels passing it is written straight into
+	 * the row, and the barycentric coordinates aren't kept
+	 * \param covered set to a bit for every pixel of the span covered by the triangle
+	 * \return a bit for every pixel whose depth was written
+	 */
+	static unsigned writeDepth(const TriangleSetup& setup, const int64_t* w, float* depthRow, unsigned inside,
+	                           unsigned& covered);
+};
+
+#ifdef FAKEGL_X86
+/**
+ * \brief Processes spans of 4 pixels with SSE2, which every x86-64 CPU supports
+ */
+struct Sse2Kernel
+{
+	static constexpr int WIDTH = 4;
+
+	static unsigned evaluate(const TriangleSetup& setup, const int64_t* w, const float* depthRow, unsigned inside,
+	                         PixelSpan<WIDTH>& span);
+	static unsigned writeDepth(const TriangleSetup& setup, const int64_t* w, float* depthRow, unsigned inside,
+	                           unsigned& covered);
+};
+
+/**
+ * \brief Processes spans of 8 pixels with AVX2
+ */
+struct Avx2Kernel
+{
+	static constexpr int WIDTH = 8;
+
+	FAKEGL_TARGET_AVX2
+	static unsigned evaluate(const TriangleSetup& setup, const int64_t* w, const float* depthRow, unsigned inside,
+	                         PixelSpan<WIDTH>& span);
+	FAKEGL_TARGET_AVX2
+	static unsigned writeDepth(const TriangleSetup& setup, const int64_t* w, float* depthRow, unsigned inside,
+	                           unsigned& covered);
+};
+#endif
@@ -0,0 +1,56 @@
+﻿#include "RenderTarget.h"
+
+#include <cstddef>
+
+#include "RasterKernels.h"
+
+RenderTarget::RenderTarget(int width, int height) : width{ width }, height{ height },
+	storage(static_cast<size_t>(width) * height + ALIGNMENT / sizeof(uint32_t))
+{
+	const auto address = reinterpret_cast<uintptr_t>(storage.data());
+	const size_t offset = (ALIGNMENT - address % ALIGNMENT) % ALIGNMENT;
+	pixels = storage.data() + offset / sizeof(uint32_t);
+}
+
+ofColor RenderTarget::getColor(int x, int y) const
+{
+	unsigned char pixel[CHANNELS];
+	std::memcpy(pixel, &pixels[y * width + x], sizeof(pixel));
+	return ofColor(pixel[0], pixel[1], pixel[2], pixel[3]);
+}
+
+void RenderTarget::clear(const ofColor& color)
+{
+	const uint32_t packed = pack(color);
+	const size_t count = static_cast<size_t>(width) * height;
+	size_t i = 0;
+
+#ifdef FAKEGL_X86
+	// The buffer is aligned, four pixels are written at once with aligned stores
+	const __m128i value = _mm_set1_epi32(static_cast<int>(packed));
+	for (; i + 4 <= count; i += 4)
+		_mm_store_si128(reinterpret_cast<__m128i*>(pixels + i), value);
+#endif
+
+	std::fill(pixels + i, pixels + count, packed);
+}
+
+int RenderTarget::getWidth() const
+{
+	return width;
+}
+
+int RenderTarget::getHeight() const
+{
+	return height;
+}
+
+const unsigned char* RenderTarget::getData() const
+{
+	return reinterpret_cast<const unsigned char*>(pixels);
+}
+
+unsigned char* RenderTarget::getData()
+{
+	return reinterpret_cast<unsigned char*>(pixels);
+}
@@ -0,0 +1,90 @@
+﻿#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "ofColor.h"
+
+/**
+ * \brief A plain RGBA image in memory, 8 bits per channel, which the renderer draws into. Doesn't need a window or
+ * an OpenGL context, unlike ofImage.
+ * Every pixel is packed in 32 bits, the R, G, B and A bytes in this order in memory. The rows follow each other
+ * without padding, so the pixels can be handed to openFrameworks as they are, and the buffer starts on a cache line
+ */
+class RenderTarget
+{
+public:
+	static constexpr int CHANNELS = 4;
+	// The alignment of the first pixel, in bytes
+	static constexpr int ALIGNMENT = 64;
+
+	RenderTarget(int width, int height);
+	RenderTarget(const RenderTarget&) = delete;
+	void operator=(const RenderTarget&) = delete;
+
+	/**
+	 * \return the color packed the way the pixels are stored
+	 */
+	static uint32_t pack(const ofColor& color)
+	{
+		const unsigned char bytes[CHANNELS] = { color.r, color.g, color.b, color.a };
+		uint32_t packed;
+		std::memcpy(&packed, bytes, sizeof(packed));
+		return packed;
+	}
+
+	void setColor(int x, int y, const ofColor& color)
+	{
+		pixels[y * width + x] = pack(color);
+	}
+
+	/**
+	 * \brief Writes the pixels of a horizontal span, already packed
+	 * \param x the first pixel of the span
+	 * \param colors the colors of the WIDTH pixels of the span
+	 * \param mask a bit for every pixel written, the other ones are left untouched
+	 */
+	template <int WIDTH>
+	void setSpan(int x, int y, const uint32_t* colors, unsigned mask)
+	{
+		uint32_t* row = pixels + y * width + x;
+
+		// Whole spans are a single copy of a few vector registers
+		if (mask == (1u << WIDTH) - 1)
+		{
+			std::copy_n(colors, WIDTH, row);
+			return;
+		}
+
+		// Pixels outside of the mask may belong to another thread, they must not be written at all
+		for (; mask != 0; mask &= mask - 1)
+		{
+			int lane = 0;
+			while ((mask & 1u << lane) == 0) lane++;
+			row[lane] = colors[lane];
+		}
+	}
+
+	ofColor getColor(int x, int y) const;
+
+	/**
+	 * \brief Sets every pixel to the given color
+	 */
+	void clear(const ofColor& color);
+
+	int getWidth() const;
+	int getHeight() const;
+
+	/**
+	 * \return the pixels, row by row starting from the top, CHANNELS bytes per pixel
+	 */
+	const unsigned char* getData() const;
+	unsigned char* getData();
+
+private:
+	int width, height;
+	// Allocated with room to spare, pixels points at its first aligned element
+	std::vector<uint32_t> storage;
+	uint32_t* pixels;
+};
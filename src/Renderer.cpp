@@ -1,23 +1,87 @@
 ﻿#include "Renderer.h"
 
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+
+#include "CommandBuffer.h"
 #include "ofImage.h"
+#include "Texture.h"
 #include "glm/glm.hpp"
 #include "glm/vec3.hpp"
 #include "glm/vec4.hpp"
 
-float triangleArea(glm::vec3* tri);
-glm::vec3 getBarycentric(glm::vec3* tri, glm::vec3 pt);
-glm::vec4 getTriangleBounds(glm::vec2* triangle, int texWidth, int texHeight);
+// Triangles reaching further than this many pixels away from the screen are discarded, as their fixed point edge
+// equations would overflow
+constexpr float GUARD_BAND = 1 << 20;
+
+namespace
+{
+	/**
+	 * \return the area on screen of the triangle a setup was made from, in pixels. A clipped triangle only covers part
+	 * of it, its area is scaled up by the part of the original triangle it keeps
+	 */
+	float getScreenArea(const TriangleSetup& setup)
+	{
+		// invArea is the inverse of twice the area, in squared sub-pixel units
+		constexpr float one = 1 << TriangleSetup::SUBPIXEL_BITS;
+		const float area = 0.5f / (setup.invArea * one * one);
+		if (!setup.clipped) return area;
+
+		// The area of the clipped triangle in barycentric coordinates, relative to the one of the original triangle
+		const glm::vec3* b = setup.clipBarycentric;
+		const float part = std::abs((b[1].y - b[0].y) * (b[2].z - b[0].z) - (b[1].z - b[0].z) * (b[2].y - b[0].y));
+		return part > 0 ? area / part : area;
+	}
+}
 
-Renderer::Renderer(const int width, const int height) : TexWidth { width }, TexHeight{ height }, depthBuffer{ width, height }, shader{ nullptr }, clearColor{ 255, 255 }
+Renderer::Renderer(const int width, const int height, const unsigned threadCount, const bool pinThreads) : TexWidth { width }, TexHeight{ height },
+	target{ new RenderTarget{ width, height } }, frontTarget{ new RenderTarget{ width, height } },
+	depthBuffer{ width, height }, shader{ nullptr }, clearColor{ 255, 255 },
+	simdLevel{ detectSimdLevel() }, tilesX{ (width + TILE_SIZE - 1) / TILE_SIZE }, tilesY{ (height + TILE_SIZE - 1) / TILE_SIZE }, threads{ threadCount, pinThreads }
 {
-	pix.allocate(width,  height, 4);
+	tileActive.resize(tilesX * tilesY);
+	visibility.resize(width * height, VisibilitySample{ -1, {} });
+}
+
+Renderer::~Renderer()
+{
+	// The commands use the renderer, they can't outlive it
+	try
+	{
+		wait();
+	}
+	catch (...)
+	{
+	}
 }
 
 void Renderer::clearBuffers()
 {
 	depthBuffer.clear(1000);
-	pix.setColor(clearColor);
+	target->clear(clearColor);
+
+	// A new frame starts, the counters of the previous one go to the timeline
+	if (counters.trianglesIn != 0)
+		trace.recordCounters(counters, TraceRecorder::Clock::now());
+	counters = PipelineCounters{};
+
+	// The draws that weren't resolved are lost
+	if (!deferredDraws.empty())
+	{
+		deferredDraws.clear();
+		deferredTriangles.clear();
+		deferredTriangleDraws.clear();
+		deferredInstances.clear();
+		std::fill(visibility.begin(), visibility.end(), VisibilitySample{ -1, {} });
+	}
+}
+
+void Renderer::clearDepth()
+{
+	depthBuffer.clear(1000);
 }
 
 void Renderer::setShader(ShaderProgram* s)
@@ -37,28 +101,428 @@ void Renderer::setClearColor(ofColor col)
 
 ofImage Renderer::getTexture() const
 {
-	ofImage img{ pix };
+	// The pixels of the target are wrapped as they are, the image makes the only copy
+	ofPixels pixels;
+	pixels.setFromExternalPixels(const_cast<unsigned char*>(target->getData()), TexWidth, TexHeight, OF_PIXELS_RGBA);
+
+	ofImage img{ pixels };
 	// This sets the upscaling filter to linear, to avoid blurring when the window's resolution is greater
 	// than the "renderbuffer" resolution
 	img.getTexture().setTextureMinMagFilter(GL_LINEAR, GL_NEAREST);
 	return img;
 }
 
+const RenderTarget& Renderer::getTarget() const
+{
+	return *target;
+}
+
+const RenderTarget& Renderer::getFrontTarget() const
+{
+	return *frontTarget;
+}
+
+void Renderer::swapTargets()
+{
+	std::swap(target, frontTarget);
+}
+
+void Renderer::setSimdLevel(SimdLevel level)
+{
+	simdLevel = level;
+}
+
+SimdLevel Renderer::getSimdLevel() const
+{
+	return simdLevel;
+}
+
+void Renderer::setCullMode(CullMode mode)
+{
+	cullMode = mode;
+}
+
+CullMode Renderer::getCullMode() const
+{
+	return cullMode;
+}
+
+void Renderer::setFrontFace(Winding winding)
+{
+	frontFace = winding;
+}
+
+Winding Renderer::getFrontFace() const
+{
+	return frontFace;
+}
+
+void Renderer::setDeferred(bool value)
+{
+	if (!value) resolve();
+	deferred = value;
+}
 
-void Renderer::renderTriangle(const glm::vec3* tri, std::vector<VertexData*> data)
+bool Renderer::isDeferred() const
+{
+	return deferred;
+}
+
+void Renderer::resolve()
+{
+	if (deferredDraws.empty()) return;
+
+	StageTimer timer{ counters.shadingSeconds, trace, "resolve" };
+
+	// Like triangles, pixels are shaded in parallel, one tile per thread
+	threads.run(tilesX * tilesY, [this](int tile)
+	{
+		int minX, minY, maxX, maxY;
+		getTileBounds(tile, minX, minY, maxX, maxY);
+
+		PipelineCounters tileCounters;
+		{
+			StageTimer tileTimer{ tileCounters.threadSeconds, trace, "shade tile" };
+			shadeTile(minX, minY, maxX, maxY, tileCounters);
+		}
+		addCounters(tileCounters);
+	});
+
+	deferredDraws.clear();
+	deferredTriangles.clear();
+	deferredTriangleDraws.clear();
+	deferredInstances.clear();
+	std::fill(visibility.begin(), visibility.end(), VisibilitySample{ -1, {} });
+}
+
+void Renderer::shadeTile(int minX, int minY, int maxX, int maxY, PipelineCounters& stats)
+{
+	for (int y = minY; y <= maxY; y++)
+	{
+		const VisibilitySample* row = &visibility[y * TexWidth];
+		int x = minX;
+		while (x <= maxX)
+		{
+			if (row[x].triangle < 0)
+			{
+				x++;
+				continue;
+			}
+
+			// The run goes on as long as the pixels show triangles of the same draw
+			const int draw = deferredTriangleDraws[row[x].triangle];
+			int last = x;
+			while (last < maxX && row[last + 1].triangle >= 0 && deferredTriangleDraws[row[last + 1].triangle] == draw)
+				last++;
+
+			deferredDraws[draw]->shadeRun(*this, y, x, last, stats);
+			x = last + 1;
+		}
+	}
+}
+
+const DepthBuffer& Renderer::getDepthBuffer() const
+{
+	return depthBuffer;
+}
+
+void Renderer::swapDepthBuffer(DepthBuffer& other)
+{
+	if (other.getWidth() != TexWidth || other.getHeight() != TexHeight)
+	{
+		std::cerr << "Error, a depth buffer can only be swapped with one of the same size";
+		throw std::bad_function_call();
+	}
+
+	depthBuffer.swap(other);
+}
+
+bool Renderer::isOccluded(const BoundingBox& bounds, const glm::mat4& viewProjection) const
+{
+	if (bounds.isEmpty()) return false;
+
+	// The projection of the box is contained by the projections of its corners, as long as they are all in front
+	float minZ = std::numeric_limits<float>::infinity();
+	glm::vec2 screenMin{ std::numeric_limits<float>::infinity() };
+	glm::vec2 screenMax{ -std::numeric_limits<float>::infinity() };
+	for (int corner = 0; corner < 8; corner++)
+	{
+		const glm::vec4 point{
+			corner & 1 ? bounds.max.x : bounds.min.x,
+			corner & 2 ? bounds.max.y : bounds.min.y,
+			corner & 4 ? bounds.max.z : bounds.min.z,
+			1
+		};
+		const glm::vec4 clip = viewProjection * point;
+		if (clip.z < 0 || clip.w <= 0) return false;
+
+		const glm::vec2 screen{ (clip.x / clip.w + 1) * TexWidth / 2.0f, (clip.y / clip.w + 1) * TexHeight / 2.0f };
+		// Like for triangles, the negated comparisons also get rid of NaNs
+		if (!(std::abs(screen.x) < GUARD_BAND && std::abs(screen.y) < GUARD_BAND)) return false;
+
+		screenMin = glm::min(screenMin, screen);
+		screenMax = glm::max(screenMax, screen);
+		minZ = std::min(minZ, clip.z / clip.w);
+	}
+
+	// Every pixel the box may touch, clamped to the screen. Boxes off the screen are left to frustum culling
+	const int minX = static_cast<int>(std::max(std::floor(screenMin.x), 0.0f));
+	const int minY = static_cast<int>(std::max(std::floor(screenMin.y), 0.0f));
+	const int maxX = static_cast<int>(std::min(std::ceil(screenMax.x), TexWidth - 1.0f));
+	const int maxY = static_cast<int>(std::min(std::ceil(screenMax.y), TexHeight - 1.0f));
+	if (minX > maxX || minY > maxY) return false;
+
+	// The same test as the one skipping the tiles of a triangle when binning it
+	return minZ >= depthBuffer.getMaxDepth(minX, minY, maxX, maxY);
+}
+
+const PipelineCounters& Renderer::getCounters() const
+{
+	return counters;
+}
+
+TraceRecorder& Renderer::getTrace()
+{
+	return trace;
+}
+
+void Renderer::submit(CommandBuffer& commands)
+{
+	wait();
+
+	threads.spawn(submission, [this, &commands] { commands.execute(*this); });
+}
+
+void Renderer::wait()
+{
+	// The waiting thread works on the batches of the commands meanwhile
+	threads.wait(submission);
+}
+
+
+void Renderer::drawIndexed(const std::vector<glm::vec3>& vertices, const VertexData& data, const std::vector<unsigned>& indices)
 {
 	if (shader == nullptr) return;
 
-	// Get the screen coordinates of the triangle
-	glm::vec4 processedVerts[] = {
-		shader->runVertexShader(tri[0], data[0]),
-		shader->runVertexShader(tri[1], data[1]),
-		shader->runVertexShader(tri[2], data[2])
+	drawIndexed(*shader, vertices, data, indices);
+}
+
+void Renderer::drawDepth(const std::vector<glm::vec3>& vertices, const std::vector<unsigned>& indices,
+                          const glm::mat4& transform)
+{
+	// The pending draws would be shaded where the new depths hide them
+	resolve();
+
+	// Vertex stage: only the position, no shader
+	{
+		StageTimer timer{ counters.vertexSeconds, trace, "vertex" };
+
+		transformedVerts.resize(vertices.size());
+
+		const int jobCount = static_cast<int>((vertices.size() + VERTEX_CHUNK_SIZE - 1) / VERTEX_CHUNK_SIZE);
+		threads.run(jobCount, [&](int job)
+		{
+			const size_t begin = static_cast<size_t>(job) * VERTEX_CHUNK_SIZE;
+			const size_t end = std::min<size_t>(begin + VERTEX_CHUNK_SIZE, vertices.size());
+
+			PipelineCounters jobCounters;
+			{
+				StageTimer jobTimer{ jobCounters.threadSeconds, trace, "vertex chunk" };
+				for (size_t i = begin; i < end; i++)
+					transformedVerts[i] = transform * glm::vec4{ vertices[i], 1 };
+			}
+			addCounters(jobCounters);
+		});
+	}
+
+	drawInstances.assign(1, { &transformedVerts, nullptr, nullptr });
+	{
+		StageTimer timer{ counters.assemblySeconds, trace, "assembly" };
+		assembleTriangles(indices);
+	}
+
+	DepthOnly pass;
+	flush(pass);
+	drawInstances.clear();
+}
+
+template <class Kernel>
+bool Renderer::rasterize(DepthOnly&, const QueuedTriangle& triangle, int minX, int minY, int maxX, int maxY,
+                         PipelineCounters& stats)
+{
+	constexpr int WIDTH = Kernel::WIDTH;
+	constexpr unsigned FULL_SPAN = (1u << WIDTH) - 1;
+
+	const TriangleSetup& setup = triangle.setup;
+	bool drawn = false;
+
+	// The same walk as the other rasterize(), only the kernel differs
+	const int startX = minX & ~(WIDTH - 1);
+
+	int64_t row[3];
+	for (int i = 0; i < 3; i++)
+		row[i] = setup.stepX[i] * startX + setup.stepY[i] * minY + setup.origin[i];
+
+	for (int y = minY; y <= maxY; y++)
+	{
+		int64_t w[3] = { row[0], row[1], row[2] };
+		float* depthRow = depthBuffer.getRow(y);
+
+		for (int x = startX; x <= maxX; x += WIDTH)
+		{
+			unsigned inside = FULL_SPAN;
+			if (x < minX) inside &= FULL_SPAN << (minX - x);
+			if (x + WIDTH - 1 > maxX) inside &= FULL_SPAN >> (x + WIDTH - 1 - maxX);
+
+			unsigned covered;
+			const unsigned mask = Kernel::writeDepth(setup, w, depthRow + x, inside, covered);
+			drawn |= mask != 0;
+
+			FAKEGL_STAT(stats.pixelsTested += countBits(inside));
+			FAKEGL_STAT(stats.pixelsCovered += countBits(covered));
+			FAKEGL_STAT(stats.depthPassed += countBits(mask));
+			FAKEGL_STAT(stats.depthFailed += countBits(covered & ~mask));
+
+			for (int i = 0; i < 3; i++)
+				w[i] += setup.stepX[i] * WIDTH;
+		}
+
+		for (int i = 0; i < 3; i++)
+			row[i] += setup.stepY[i];
+	}
+
+	return drawn;
+}
+
+void Renderer::assembleTriangles(const std::vector<unsigned>& indices)
+{
+	// The triangles of every instance, one instance after the other
+	const int instanceTriangles = static_cast<int>(indices.size() / 3);
+	const int triangleCount = instanceTriangles * static_cast<int>(drawInstances.size());
+	chunkCount = (triangleCount + TRIANGLE_CHUNK_SIZE - 1) / TRIANGLE_CHUNK_SIZE;
+	if (static_cast<int>(chunks.size()) < chunkCount) chunks.resize(chunkCount);
+
+	threads.run(chunkCount, [this, &indices, instanceTriangles, triangleCount](int job)
+	{
+		TriangleChunk& chunk = chunks[job];
+		if (chunk.bins.empty()) chunk.bins.resize(tilesX * tilesY);
+
+		chunk.counters = {};
+		{
+			StageTimer jobTimer{ chunk.counters.threadSeconds, trace, "assembly chunk" };
+
+			const int end = std::min(job * TRIANGLE_CHUNK_SIZE + TRIANGLE_CHUNK_SIZE, triangleCount);
+			for (int i = job * TRIANGLE_CHUNK_SIZE; i < end; i++)
+			{
+				const int instance = i / instanceTriangles;
+				const int triangle = i - instance * instanceTriangles;
+				assembleTriangle(indices.data() + 3 * triangle, drawInstances[instance], chunk);
+			}
+		}
+		addCounters(chunk.counters);
+	});
+
+	// Gather the tiles to draw and the data of the deferred triangles, in the order of the chunks
+	for (int i = 0; i < chunkCount; i++)
+	{
+		TriangleChunk& chunk = chunks[i];
+		for (const int tile : chunk.activeTiles)
+		{
+			if (tileActive[tile]) continue;
+			tileActive[tile] = true;
+			activeTiles.push_back(tile);
+		}
+
+		// The triangles of depth-only draws are never shaded
+		if (!deferred || drawData == nullptr) continue;
+
+		const int offset = static_cast<int>(deferredTriangles.size());
+		for (auto& triangle : chunk.queue)
+			triangle.deferredIndex += offset;
+		deferredTriangles.insert(deferredTriangles.end(), chunk.deferredTriangles.begin(), chunk.deferredTriangles.end());
+		deferredTriangleDraws.resize(deferredTriangles.size(), static_cast<int>(deferredDraws.size()));
+	}
+
+	// The threads start with contiguous ranges of tiles, neighbouring tiles share more triangles
+	std::sort(activeTiles.begin(), activeTiles.end());
+}
+
+void Renderer::assembleTriangle(const unsigned* vertices, const DrawInstance& instance, TriangleChunk& chunk)
+{
+	const std::vector<glm::vec4>& positions = *instance.positions;
+	const glm::vec4 processedVerts[] = {
+		positions[vertices[0]],
+		positions[vertices[1]],
+		positions[vertices[2]]
 	};
 
-	// Don't process triangles with at least one vertex whose z coordinate is outside of [0, 100]
-	if (std::any_of(processedVerts, processedVerts + 3, [](glm::vec3 vert) {return vert.z <= 0 || vert.z >= 100; }))
+	FAKEGL_STAT(chunk.counters.trianglesIn++);
+
+	/* The view frustum is -w <= x <= w, -w <= y <= w, 0 <= z <= w. A triangle whose vertices are all outside of the same
+	 * plane can't be seen. Triangles partially outside of the sides are left to the guard band and the screen bounds of
+	 * the rasterizer, only the near plane has to be clipped, as the perspective division only works in front of it
+	 */
+	unsigned outside = ~0u;
+	for (const auto& vert : processedVerts)
+	{
+		outside &= (vert.x < -vert.w) << 0 | (vert.x > vert.w) << 1 | (vert.y < -vert.w) << 2 |
+		           (vert.y > vert.w) << 3 | (vert.z < 0) << 4 | (vert.z > vert.w) << 5;
+	}
+	if (outside != 0)
+	{
+		FAKEGL_STAT(chunk.counters.trianglesOutsideFrustum++);
+		return;
+	}
+
+	if (processedVerts[0].z >= 0 && processedVerts[1].z >= 0 && processedVerts[2].z >= 0)
+	{
+		submitTriangle(processedVerts, nullptr, vertices, instance, chunk);
 		return;
+	}
+
+	FAKEGL_STAT(chunk.counters.trianglesClipped++);
+
+	// The barycentric coordinates of the vertices of the original triangle
+	const glm::vec3 corners[] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+
+	// Clip the triangle against the near plane z = 0, the part in front of it has either 3 or 4 vertices
+	glm::vec4 polygon[4];
+	glm::vec3 polygonBarycentric[4];
+	int count = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		const int j = (i + 1) % 3;
+		const float from = processedVerts[i].z;
+		const float to = processedVerts[j].z;
+
+		if (from >= 0)
+		{
+			polygon[count] = processedVerts[i];
+			polygonBarycentric[count++] = corners[i];
+		}
+
+		// The edge crosses the plane, add the intersection
+		if ((from >= 0) != (to >= 0))
+		{
+			const float t = from / (from - to);
+			polygon[count] = processedVerts[i] + (processedVerts[j] - processedVerts[i]) * t;
+			polygonBarycentric[count++] = corners[i] + (corners[j] - corners[i]) * t;
+		}
+	}
+
+	// Split the polygon in triangles, all sharing its first vertex
+	for (int i = 1; i + 1 < count; i++)
+	{
+		const glm::vec4 triangle[] = { polygon[0], polygon[i], polygon[i + 1] };
+		const glm::vec3 barycentric[] = { polygonBarycentric[0], polygonBarycentric[i], polygonBarycentric[i + 1] };
+		submitTriangle(triangle, barycentric, vertices, instance, chunk);
+	}
+}
+
+void Renderer::submitTriangle(const glm::vec4* triangle, const glm::vec3* clipBarycentric, const unsigned* vertices,
+                              const DrawInstance& instance, TriangleChunk& chunk)
+{
+	glm::vec4 processedVerts[] = { triangle[0], triangle[1], triangle[2] };
 
 	// Perspective division
 	for (auto& vert : processedVerts)
@@ -71,16 +535,6 @@ void Renderer::renderTriangle(const glm::vec3* tri, std::vector<VertexData*> dat
 		}
 	}
 
-	// Remove the z and w coordinates
-	glm::vec2 screenCoords[] = {
-		processedVerts[0],
-		processedVerts[1],
-		processedVerts[2]
-	};
-
-	// Get the smallest rectangle containing the entirety of the triangle (clamped in the range [0, width] for the x values and [0, height] for the y values)
-	glm::vec4 bounds = getTriangleBounds(screenCoords, TexWidth, TexHeight);
-
 	// Get rid of the w component, not needed anymore
 	glm::vec3 fragmentTriangle[] = {
 		processedVerts[0],
@@ -88,115 +542,208 @@ void Renderer::renderTriangle(const glm::vec3* tri, std::vector<VertexData*> dat
 		processedVerts[2]
 	};
 
-	// Draw it!
-	processTriangle(fragmentTriangle, bounds[0], bounds[1], bounds[2], bounds[3], TexWidth, TexHeight, data);
+	TriangleSetup setup;
+	if (!setupTriangle(fragmentTriangle, setup))
+	{
+		FAKEGL_STAT(chunk.counters.trianglesCulled++);
+		return;
+	}
+
+	setup.clipped = clipBarycentric != nullptr;
+	if (setup.clipped)
+		std::copy_n(clipBarycentric, 3, setup.clipBarycentric);
+
+	// Queue it, flush() draws it!
+	binTriangle(setup, vertices, instance, chunk);
 }
 
-/**
- * \brief Computes the bounds of a given triangle
- * \param triangle the triangle, expects three glm::vec2
- * \return a glm::vec4 with the structure {minX, minY, maxX, maxY}
- */
-glm::vec4 getTriangleBounds(glm::vec2* triangle, int texWidth, int texHeight)
+void Renderer::binTriangle(const TriangleSetup& setup, const unsigned* vertices, const DrawInstance& instance,
+                           TriangleChunk& chunk)
 {
-	glm::vec4 out{};
-	for (int i = 0; i < 3; i++)
+	const int index = static_cast<int>(chunk.queue.size());
+	bool binned = false;
+
+	for (int tileY = setup.minY / TILE_SIZE; tileY <= setup.maxY / TILE_SIZE; tileY++)
 	{
-		out[0] = std::min(triangle[i].x, out[0]);
-		out[1] = std::min(triangle[i].y, out[1]);
+		for (int tileX = setup.minX / TILE_SIZE; tileX <= setup.maxX / TILE_SIZE; tileX++)
+		{
+			const int tile = tileY * tilesX + tileX;
+
+			// Skip the tiles where the triangle is entirely behind what the previous draws left in the depth buffer
+			int minX, minY, maxX, maxY;
+			getTileBounds(tile, minX, minY, maxX, maxY);
+			const float maxDepth = depthBuffer.getMaxDepth(std::max(minX, setup.minX), std::max(minY, setup.minY),
+			                                               std::min(maxX, setup.maxX), std::min(maxY, setup.maxY));
+			if (setup.minZ >= maxDepth) continue;
+
+			binned = true;
+			if (chunk.bins[tile].empty())
+				chunk.activeTiles.push_back(tile);
+			chunk.bins[tile].push_back(index);
+		}
+	}
 
-		out[2] = std::max(triangle[i].x, out[2]);
-		out[3] = std::max(triangle[i].y, out[3]);
+	if (!binned)
+	{
+		FAKEGL_STAT(chunk.counters.trianglesHidden++);
+		return;
 	}
 
-	out[0] += 1;
-	out[0] *= texWidth / 2.0f;
+	FAKEGL_STAT(chunk.counters.trianglesQueued++);
+	chunk.queue.emplace_back();
+	chunk.queue.back().setup = setup;
 
-	out[1] += 1;
-	out[1] *= texHeight / 2.0f;
+	// Depth-only draws don't read any vertex data
+	if (instance.outputs == nullptr) return;
 
-	out[2] += 1;
-	out[2] *= texWidth / 2.0f;
+	// The vertex data is gathered only once, no matter how many tiles and pixels the triangle covers
+	TriangleContext* context = &chunk.queue.back().context;
+	if (deferred)
+	{
+		// It has to outlive the queue, until the triangle is shaded by resolve(). The index is made relative to
+		// deferredTriangles once all of the chunks are binned
+		chunk.queue.back().deferredIndex = static_cast<int>(chunk.deferredTriangles.size());
+		chunk.deferredTriangles.emplace_back();
+		context = &chunk.deferredTriangles.back();
+	}
+	context->load(vertices, *drawData, *instance.outputs);
+	if (!drawData->uvs.empty())
+		context->uvLod = Texture::getTriangleLod(context->uvs, getScreenArea(setup));
 
-	out[3] += 1;
-	out[3] *= texHeight / 2.0f;
+	// The color of an instance tints the whole triangle, so the shaders don't have to know about it
+	if (instance.uniforms != nullptr)
+	{
+		context->instance = instance.uniforms;
+		for (auto& color : context->colors)
+			color = color * instance.uniforms->color;
+	}
+}
 
-	// Cut away anything that goes outside of the screen
-	out[0] = ofClamp(out[0], 0, texWidth - 1);
-	out[2] = ofClamp(out[2], 0, texWidth - 1);
-	out[1] = ofClamp(out[1], 0, texHeight - 1);
-	out[3] = ofClamp(out[3], 0, texHeight - 1);
+void Renderer::getTileBounds(int tile, int& minX, int& minY, int& maxX, int& maxY) const
+{
+	minX = (tile % tilesX) * TILE_SIZE;
+	minY = (tile / tilesX) * TILE_SIZE;
+	maxX = std::min(minX + TILE_SIZE, TexWidth) - 1;
+	maxY = std::min(minY + TILE_SIZE, TexHeight) - 1;
+}
 
-	return out;
+void Renderer::clearQueue()
+{
+	// Clearing keeps the allocated memory around for the next batch
+	for (int i = 0; i < chunkCount; i++)
+	{
+		TriangleChunk& chunk = chunks[i];
+		for (const int tile : chunk.activeTiles)
+			chunk.bins[tile].clear();
+		chunk.activeTiles.clear();
+		chunk.queue.clear();
+		chunk.deferredTriangles.clear();
+	}
+	chunkCount = 0;
+
+	for (const int tile : activeTiles)
+		tileActive[tile] = false;
+	activeTiles.clear();
 }
 
-void Renderer::processTriangle(glm::vec3* triangle, int minX, int minY, int maxX, int maxY, float texWidth, float texHeight, std::vector<VertexData*> data)
+void Renderer::addCounters(const PipelineCounters& threadCounters)
 {
-	// Sets z to 0
-	glm::vec3 screenTri[] = {
-		{triangle[0].x, triangle[0].y, 0},
-		{triangle[1].x, triangle[1].y, 0},
-		{triangle[2].x, triangle[2].y, 0}
-	};
+#if FAKEGL_STATS
+	std::lock_guard<std::mutex> lock{ countersMutex };
+	counters.add(threadCounters);
+#endif
+}
+
+bool Renderer::setupTriangle(const glm::vec3* triangle, TriangleSetup& setup) const
+{
+	constexpr int64_t one = int64_t{ 1 } << TriangleSetup::SUBPIXEL_BITS;
 
-	// Iterate over all the pixel coordinates of the bounds
-	for (int x = minX; x <= maxX; x++)
+	// Map the vertices from the range [-1, 1] to pixel coordinates, then snap them to the sub-pixel grid
+	int64_t vx[3], vy[3];
+	for (int i = 0; i < 3; i++)
 	{
-		for (int y = minY; y <= maxY; y++)
-		{
-			// Map the x and y in the range [-1, 1]
-			const float ndcX = x / texWidth * 2 - 1;
-			const float ndcY = y / texHeight * 2 - 1;
+		const float x = (triangle[i].x + 1) * TexWidth / 2.0f;
+		const float y = (triangle[i].y + 1) * TexHeight / 2.0f;
 
-			// Get the barycentric coordinates of the pixel ndc inside of the triangle
-			glm::vec3 barycentric = getBarycentric(screenTri, glm::vec3(ndcX, ndcY, 0));
+		// The negated comparisons also get rid of NaNs
+		if (!(std::abs(x) < GUARD_BAND && std::abs(y) < GUARD_BAND)) return false;
 
-			// When one of the barycentric is < 0, it means that the given point is out of the triangle, skip!
-			if (barycentric.x >= 0 && barycentric.y >= 0 && barycentric.z >= 0) {
-				// Obtain the z-value of the fragment by interpolating the z of the vertices
-				float zVal = 0;
-				for (int i = 0; i < 3; i++)
-					zVal += triangle[i].z * barycentric[i];
+		vx[i] = std::llround(x * one);
+		vy[i] = std::llround(y * one);
+		setup.z[i] = triangle[i].z;
+	}
 
-				// depth-testing, draw only if the current z is greater than the written one
-				if (depthBuffer.get(x, y) <= zVal) continue;
+	// Get the smallest rectangle of pixels containing the entirety of the triangle, cutting away anything that goes
+	// outside of the screen
+	const int64_t minX = std::min({ vx[0], vx[1], vx[2] });
+	const int64_t minY = std::min({ vy[0], vy[1], vy[2] });
+	const int64_t maxX = std::max({ vx[0], vx[1], vx[2] });
+	const int64_t maxY = std::max({ vy[0], vy[1], vy[2] });
+
+	// Round the minimums up and the maximums down, pixels outside of that range can't be covered
+	setup.minX = static_cast<int>(std::max<int64_t>((minX + one - 1) >> TriangleSetup::SUBPIXEL_BITS, 0));
+	setup.minY = static_cast<int>(std::max<int64_t>((minY + one - 1) >> TriangleSetup::SUBPIXEL_BITS, 0));
+	setup.maxX = static_cast<int>(std::min<int64_t>(maxX >> TriangleSetup::SUBPIXEL_BITS, TexWidth - 1));
+	setup.maxY = static_cast<int>(std::min<int64_t>(maxY >> TriangleSetup::SUBPIXEL_BITS, TexHeight - 1));
+
+	if (setup.minX > setup.maxX || setup.minY > setup.maxY) return false;
+
+	/* The edge function of the edge going from a to b is positive on its left, zero on the edge itself:
+	 * E(p) = (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x)
+	 * Expanding it gives the coefficients of p.x and p.y, which are the increments used to step from one pixel to the next
+	 */
+	int64_t a[3], b[3], c[3];
+	for (int i = 0; i < 3; i++)
+	{
+		const int j = (i + 1) % 3;
+		const int k = (i + 2) % 3;
 
-				// Get the fragment's color
-				ofColor col = shader->runFragmentShader(barycentric, data);
+		a[i] = vy[j] - vy[k];
+		b[i] = vx[k] - vx[j];
+		c[i] = -a[i] * vx[j] - b[i] * vy[j];
+	}
 
-				// Draw!
-				pix.setColor(x, y, col);
+	// The sum of the three edge functions is twice the area of the triangle, the same at every point
+	int64_t area = a[0] * vx[0] + b[0] * vy[0] + c[0];
+	if (area == 0) return false;
 
-				// Update depth buffer
-				depthBuffer.set(x, y, zVal);
-			}
+	// Counter-clockwise triangles have a positive area
+	const bool frontFacing = (area > 0) == (frontFace == Winding::CounterClockwise);
+	if ((cullMode == CullMode::Back && !frontFacing) || (cullMode == CullMode::Front && frontFacing)) return false;
+
+	// Both windings can be drawn: flip the edges of clockwise triangles so that the inside is always positive
+	if (area < 0)
+	{
+		area = -area;
+		for (int i = 0; i < 3; i++)
+		{
+			a[i] = -a[i];
+			b[i] = -b[i];
+			c[i] = -c[i];
 		}
 	}
-}
-
-/**
- * \brief A utility function to calculate area of a triangle formed by (x1, y1), (x2, y2) and (x3, y3)
- */
-float triangleArea(glm::vec3* tri)
-{
-	const glm::vec3 ab = tri[1] - tri[0];
-	const glm::vec3 ac = tri[2] - tri[0];
-
-	return dot(ab, ac) / 2;
-}
 
-/**
- * \brief Compute the barycentric coordinates of a point relatively to a given triangle
- * \param t the triangle
- * \param p the point
- */
-glm::vec3 getBarycentric(glm::vec3* t, glm::vec3 p)
-{
-	const float denominator = (t[1].y - t[2].y) * (t[0].x - t[2].x) + (t[2].x - t[1].x) * (t[0].y - t[2].y);
+	for (int i = 0; i < 3; i++)
+	{
+		// Pixels are sampled on integer coordinates, so a step of one pixel moves by "one" sub-pixel units
+		setup.stepX[i] = a[i] * one;
+		setup.stepY[i] = b[i] * one;
+		setup.origin[i] = c[i];
+
+		// Top-left fill rule. The y axis points down, so an edge whose value grows with x is a left edge, and a
+		// horizontal edge whose value grows with y is a top edge
+		const bool topLeft = a[i] > 0 || (a[i] == 0 && b[i] > 0);
+		setup.bias[i] = topLeft ? 0 : -1;
+	}
 
-	float wa = ((t[1].y - t[2].y) * (p.x - t[2].x) + (t[2].x - t[1].x) * (p.y - t[2].y)) / denominator;
+	setup.invArea = 1.0f / static_cast<float>(area);
+	for (int i = 0; i < 3; i++)
+		setup.baryStepX[i] = static_cast<float>(setup.stepX[i]) * setup.invArea;
 
-	float wb = ((t[2].y - t[0].y) * (p.x - t[2].x) + (t[0].x - t[2].x) * (p.y - t[2].y)) / denominator;
+	// The depth is interpolated linearly, so no pixel of the triangle is closer than its closest vertex. The margin
+	// accounts for the rounding of the barycentric coordinates
+	const float closest = std::min({ setup.z[0], setup.z[1], setup.z[2] });
+	setup.minZ = closest - std::abs(closest) * 1e-5f;
 
-	return { wa, wb, 1 - wa - wb };
-}
\ No newline at end of file
+	return true;
+}
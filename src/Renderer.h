@@ -1,27 +1,146 @@
 ﻿#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <glm/vec3.hpp>
 
+#include "Bounds.h"
 #include "DepthBuffer.h"
 #include "ofImage.h"
 #include "ofPixels.h"
+#include "PipelineStats.h"
+#include "RasterKernels.h"
+#include "RenderTarget.h"
 #include "ShaderProgram.h"
+#include "ThreadPool.h"
+
+/**
+ * \brief The edge equations of a screen-space triangle, computed once per triangle so that the rasterizer only has
+ * to step them with additions while walking the pixels
+ */
+struct TriangleSetup
+{
+	// Edge functions are evaluated in fixed point, with this many bits of sub-pixel precision
+	static constexpr int SUBPIXEL_BITS = 8;
+
+	// Edge i is the one opposite to vertex i, its value at pixel (x, y) is stepX[i] * x + stepY[i] * y + origin[i]
+	int64_t stepX[3];
+	int64_t stepY[3];
+	int64_t origin[3];
+	// 0 for top-left edges, -1 otherwise: pixels lying exactly on an edge belong to only one of the triangles sharing it
+	int64_t bias[3];
+
+	// Used to turn the edge function values into barycentric coordinates
+	float invArea;
+	// How much each barycentric coordinate changes from one pixel to the one on its right
+	float baryStepX[3];
+	// True for the triangles made by clipping a larger one
+	bool clipped;
+	// The barycentric coordinates of each vertex within the original triangle, if the triangle was clipped
+	glm::vec3 clipBarycentric[3];
+
+	// The depth of each vertex, interpolated for every covered pixel
+	float z[3];
+	// No pixel of the triangle has a depth lower than this
+	float minZ;
+
+	// The pixel bounds of the triangle, already clamped to the screen
+	int minX, minY, maxX, maxY;
+};
+
+/**
+ * \brief Which triangles are discarded depending on the side they are facing
+ */
+enum class CullMode
+{
+	None,
+	Back,
+	Front
+};
+
+/**
+ * \brief The order of the vertices of a triangle, as seen on screen
+ */
+enum class Winding
+{
+	CounterClockwise,
+	Clockwise
+};
+
+class CommandBuffer;
 
 /**
  * \brief Does all of the heavy lifting, draws funny shapes inside a window!
  */
 class Renderer {
 public:
-	Renderer(int width = 160, int height = 200);
+	// The side of the square screen tiles, in pixels. Tiles are rasterized in parallel
+	static constexpr int TILE_SIZE = 32;
+	// Every depth buffer block must belong to a single tile, so that threads never update the same block
+	static_assert(TILE_SIZE % DepthBuffer::BLOCK_SIZE == 0, "Tiles must be made of whole depth buffer blocks");
+	// The vertex stage transforms the vertices of a draw by chunks of this many, in parallel
+	static constexpr int VERTEX_CHUNK_SIZE = 4096;
+	// The triangles of a draw are assembled and binned by chunks of this many, in parallel
+	static constexpr int TRIANGLE_CHUNK_SIZE = 1024;
 
 	/**
-	 * \brief Renders a triangle on screen
-	 * \param tri an array of three vertex positions
+	 * \param threadCount the number of threads running the jobs of every stage: chunks of vertices, chunks of triangles
+	 * and tiles
+	 * \param pinThreads true to bind each thread to its own core
+	 */
+	Renderer(int width = 160, int height = 200, unsigned threadCount = std::thread::hardware_concurrency(),
+	         bool pinThreads = false);
+	/**
+	 * \brief Waits for the commands submitted last, their errors are lost
+	 */
+	~Renderer();
+
+	/**
+	 * \brief Renders indexed triangles on screen. The vertex shader runs exactly once for every vertex, then the triangles
+	 * are assembled from the transformed vertices and drawn
+	 * \param vertices the positions of the vertices
+	 * \param data the data bound to the vertices, one element of each attribute for every vertex
+	 * \param indices every three indices in vertices form a triangle
+	 */
+	void drawIndexed(const std::vector<glm::vec3>& vertices, const VertexData& data, const std::vector<unsigned>& indices);
+	/**
+	 * \brief Same as drawIndexed(), but with the given shader instead of the one set with setShader(). The rendering loops
+	 * are instantiated for ShaderT, so that its vertex and fragment shaders are called directly and can be inlined.
+	 * If the shader is of a type derived from ShaderT, the virtual functions are called instead
+	 */
+	template <class ShaderT>
+	void drawIndexed(ShaderT& shader, const std::vector<glm::vec3>& vertices, const VertexData& data,
+	                 const std::vector<unsigned>& indices);
+	/**
+	 * \brief Draws the same indexed triangles once for every instance, each with its own transform and color. The vertex
+	 * data is shared by all of the instances; the vertex shader runs once per vertex and per instance, with the draw
+	 * uniforms of the instance, in batches of instances spread over the threads. The triangles of all of the instances go
+	 * through a single assembly and rasterization pass, in the order of the instances.
+	 * Every batch sets the uniforms on its own copy of the shader, so its draw uniforms are left as they were, unless its
+	 * actual type is unknown: the batches then run one after the other on the shader itself
+	 * \param instances the uniforms of each instance
+	 */
+	template <class ShaderT>
+	void drawInstanced(ShaderT& shader, const std::vector<glm::vec3>& vertices, const VertexData& data,
+	                   const std::vector<unsigned>& indices, const std::vector<InstanceUniforms>& instances);
+	/**
+	 * \brief Draws only the depth of indexed triangles, for instance to fill a shadow map. No shader runs and the render
+	 * target is left as it is: the vertices are multiplied by a matrix, and the rasterizer only computes and tests the depth
+	 * of the pixels, without interpolating any attribute. Given the same clip space positions, the depths written are the
+	 * same as the ones of a regular draw. In deferred mode, the pending draws are resolved first
+	 * \param transform the matrix going from the space of the vertices to clip space
 	 */
-	void renderTriangle(const glm::vec3* tri, std::vector<VertexData*> data);
+	void drawDepth(const std::vector<glm::vec3>& vertices, const std::vector<unsigned>& indices,
+	               const glm::mat4& transform);
 	/**
 	 * \brief Clears the screen buffer and the depth buffer
 	 */
 	void clearBuffers();
+	/**
+	 * \brief Clears only the depth buffer, between depth-only passes whose render target is never shown
+	 */
+	void clearDepth();
 	/**
 	 * \param shader The shader to use when rendering triangles
 	 */
@@ -34,19 +153,760 @@ public:
 	void setClearColor(ofColor col);
 
 	/**
-	 * \return the render texture 
+	 * \return the render texture. Creates a new image and texture on every call, Presenter shows the frames without
+	 * doing so
 	 */
 	ofImage	getTexture() const;
+	/**
+	 * \return the image drawn by the renderer, without going through openFrameworks. Unlike getTexture(), it can be used
+	 * without a window
+	 */
+	const RenderTarget& getTarget() const;
+	/**
+	 * \return the image drawn before the last call to swapTargets()
+	 */
+	const RenderTarget& getFrontTarget() const;
+	/**
+	 * \brief The renderer has two render targets: it draws into one of them while the other one, holding the last
+	 * finished frame, is presented. Swapping them makes the frame just drawn the front one, and the next frame is drawn
+	 * over the previous front one
+	 */
+	void swapTargets();
+
+	/**
+	 * \brief Sets the instruction set used to rasterize triangles, by default the best one supported by the CPU.
+	 * Every level produces exactly the same image, this only exists to compare them
+	 * \param level the instruction set, must be supported by the CPU
+	 */
+	void setSimdLevel(SimdLevel level);
+	SimdLevel getSimdLevel() const;
+
+	/**
+	 * \brief Sets which triangles are discarded before being drawn, none by default. Culling the back faces of closed
+	 * meshes halves the number of triangles drawn
+	 */
+	void setCullMode(CullMode mode);
+	CullMode getCullMode() const;
+	/**
+	 * \brief Sets the winding of the triangles facing the camera, counter-clockwise by default
+	 */
+	void setFrontFace(Winding winding);
+	Winding getFrontFace() const;
+
+	/**
+	 * \brief In deferred mode, draws only compute the depth of the pixels and which triangle is visible in each of them.
+	 * The fragment shader then runs exactly once for every visible pixel, when resolve() is called.
+	 * The shaders of the draws are copied, so their uniforms can be changed right after drawing. Draws made through a
+	 * ShaderProgram reference whose actual type is unknown can't be copied, they are resolved right away
+	 * \param deferred true to enable the deferred mode. Disabling it resolves the pending draws
+	 */
+	void setDeferred(bool deferred);
+	bool isDeferred() const;
+	/**
+	 * \brief Runs the fragment shader on the pixels left visible by the deferred draws. Must be called before
+	 * getTexture() in deferred mode, does nothing otherwise
+	 */
+	void resolve();
+
+	/**
+	 * \return the depth of the pixels drawn since the last clear, in normalized device coordinates
+	 */
+	const DepthBuffer& getDepthBuffer() const;
+	/**
+	 * \brief Exchanges the depth buffer of the renderer with another one of the same size, so that the result of a
+	 * depth-only pass is kept without being copied, and the next pass draws into the other buffer
+	 */
+	void swapDepthBuffer(DepthBuffer& other);
+
+	/**
+	 * \brief Tests a box against the depth buffer, to skip the meshes hidden behind the ones drawn before them.
+	 * Conservative: returns false whenever a pixel of the box might still pass the depth test, in particular when the box
+	 * crosses the near plane. Only meaningful for immediate draws, not while submitted commands are executing
+	 * \param bounds the world space box of a mesh
+	 * \param viewProjection the matrix going from world space to clip space, the perspective times the view matrix
+	 * \return true if nothing inside of the box can be visible
+	 */
+	bool isOccluded(const BoundingBox& bounds, const glm::mat4& viewProjection) const;
+
+	/**
+	 * \brief What went through the pipeline since the last call to clearBuffers(), usually the current frame. Always
+	 * zero if the statistics are compiled out with FAKEGL_STATS
+	 */
+	const PipelineCounters& getCounters() const;
+	/**
+	 * \brief The timeline of the draws, filled once enabled with getTrace().setEnabled(true)
+	 */
+	TraceRecorder& getTrace();
+
+	/**
+	 * \brief Executes the commands of a buffer as a task of the renderer's threads and returns right away, so that the
+	 * next frame can be recorded while this one is drawn. Waits for the previous submission first. Until wait()
+	 * returns, neither the renderer nor the buffer may be used, except to record into another buffer
+	 */
+	void submit(CommandBuffer& commands);
+	/**
+	 * \brief Blocks until the commands submitted last are executed, does nothing if there are none. The errors met while
+	 * executing them are thrown from here
+	 */
+	void wait();
 
 private:
+	// Executes the recorded draws, whose vertices are already transformed
+	friend class CommandBuffer;
+
 	int TexWidth;
 	int TexHeight;
 	// The structure used internally to draw. It's the internal "framebuffer"
-	ofPixels_<unsigned char> pix;
+	std::unique_ptr<RenderTarget> target;
+	// The last frame finished, shown while the next one is drawn into target
+	std::unique_ptr<RenderTarget> frontTarget;
 	DepthBuffer depthBuffer;
 	ShaderProgram * shader;
 	ofColor clearColor;
+	SimdLevel simdLevel;
+	CullMode cullMode{ CullMode::None };
+	Winding frontFace{ Winding::CounterClockwise };
+
+	PipelineCounters counters;
+	// Held by the threads adding their counters to the renderer's ones
+	std::mutex countersMutex;
+	TraceRecorder trace;
+
+	/**
+	 * \brief A triangle waiting to be drawn by flush()
+	 */
+	struct QueuedTriangle
+	{
+		TriangleSetup setup;
+		// The data of the vertices of the triangle, read by the fragment shader. Unused in deferred mode
+		TriangleContext context;
+		// The index of the triangle in deferredTriangles, in deferred mode
+		int deferredIndex;
+	};
+
+	/**
+	 * \brief What the deferred mode remembers of a pixel until it is shaded
+	 */
+	struct VisibilitySample
+	{
+		// The index of the visible triangle in deferredTriangles, -1 if there is none
+		int triangle;
+		glm::vec3 barycentric;
+	};
+
+	/**
+	 * \brief A draw whose pixels haven't been shaded yet
+	 */
+	class DeferredDraw
+	{
+	public:
+		virtual ~DeferredDraw() = default;
+
+		/**
+		 * \brief Runs the fragment shader on a run of pixels of a row, a triangle of this draw being visible in each of
+		 * them
+		 */
+		virtual void shadeRun(Renderer& renderer, int y, int minX, int maxX, PipelineCounters& stats) = 0;
+	};
+
+	/**
+	 * \brief Keeps a copy of the shader of a draw, taken when the draw is made
+	 */
+	template <class ShaderT>
+	class TypedDeferredDraw;
+
+	/**
+	 * \brief The shader transforming the vertices of a batch of instances, a copy when the actual type of the shader is
+	 * ShaderT, so that batches can set their instances' uniforms at the same time
+	 */
+	template <class ShaderT>
+	struct InstanceShader;
+
+	/**
+	 * \brief Stands for the shader of the depth-only draws, which have none. The rendering loops instantiated for it only
+	 * write the depth of the pixels
+	 */
+	struct DepthOnly {};
 
-	// The most important function of the whole project, performs all of the computations required to draw on screen
-	void processTriangle(glm::vec3* triangle, int minX, int minY, int maxX, int maxY, float texWidth, float texHeight, std::vector<VertexData*> data);
+	/**
+	 * \brief The transformed vertices of an instance of the current draw. Draws that aren't instanced have a single one
+	 */
+	struct DrawInstance
+	{
+		const std::vector<glm::vec4>* positions;
+		// nullptr for depth-only draws, whose triangles don't load any vertex data
+		const VertexOutputs* outputs;
+		// nullptr if the draw isn't instanced
+		const InstanceUniforms* uniforms;
+	};
+
+	/**
+	 * \brief The output of the vertex shader for an instance of an instanced draw
+	 */
+	struct InstanceVertices
+	{
+		std::vector<glm::vec4> positions;
+		VertexOutputs outputs;
+	};
+
+	/**
+	 * \brief The triangles assembled and binned by a single job. Tiles draw the chunks one after the other, so the
+	 * triangles are still drawn in submission order, whatever thread assembled them
+	 */
+	struct TriangleChunk
+	{
+		std::vector<QueuedTriangle> queue;
+		// For every tile, the indices of the chunk's triangles overlapping it, in submission order
+		std::vector<std::vector<int>> bins;
+		// The indices of the tiles with at least one triangle in their bin
+		std::vector<int> activeTiles;
+		// The data of the chunk's triangles in deferred mode, moved to deferredTriangles once the chunk is binned
+		std::vector<TriangleContext> deferredTriangles;
+		PipelineCounters counters;
+	};
+
+	int tilesX, tilesY;
+	// Only the first chunkCount chunks hold the triangles of the current draw, the others keep their memory for later
+	std::vector<TriangleChunk> chunks;
+	int chunkCount{ 0 };
+	// The indices of the tiles with at least one triangle in the bin of a chunk, in increasing order
+	std::vector<int> activeTiles;
+	// For every tile, whether it is in activeTiles
+	std::vector<unsigned char> tileActive;
+	// Runs the jobs of all of the stages, so that they share the cores without oversubscribing them
+	ThreadPool threads;
+
+	// The output of the vertex shader for every vertex of the last immediate draw
+	std::vector<glm::vec4> transformedVerts;
+	VertexOutputs vertexOutputs;
+	// The same for every instance of the last instanced draw, kept along with their memory for the next ones
+	std::vector<InstanceVertices> instanceVertices;
+	// The vertex data and the transformed vertices of every instance of the current draw
+	const VertexData* drawData{ nullptr };
+	std::vector<DrawInstance> drawInstances;
+
+	bool deferred{ false };
+	// The visible triangle of every pixel, row by row
+	std::vector<VisibilitySample> visibility;
+	// The data of every triangle drawn since the last resolve(), and the draw it belongs to
+	std::vector<TriangleContext> deferredTriangles;
+	std::vector<int> deferredTriangleDraws;
+	std::vector<std::unique_ptr<DeferredDraw>> deferredDraws;
+	// The uniforms of the instances of the deferred draws, pointed to by their triangles. Moving the vectors around keeps
+	// their elements in place
+	std::vector<std::vector<InstanceUniforms>> deferredInstances;
+
+	// Done once the commands of the last submit() are executed
+	ThreadPool::Fence submission;
+
+	/**
+	 * \brief Assembles, rasterizes and shades the triangles of a draw whose vertices went through the vertex stage
+	 * \param positions the clip space position of every vertex
+	 * \param outputs the other outputs of the vertex shader
+	 */
+	template <class ShaderT>
+	void drawTransformed(ShaderT& shader, const VertexData& data, const std::vector<glm::vec4>& positions,
+	                     const VertexOutputs& outputs, const std::vector<unsigned>& indices);
+	/**
+	 * \brief Same as drawTransformed(), for the instances in drawInstances
+	 */
+	template <class ShaderT>
+	void drawBatch(ShaderT& shader, const VertexData& data, const std::vector<unsigned>& indices);
+	/**
+	 * \brief Assembles and bins the triangles of every instance of a draw, a chunk of them per job, then gathers what the
+	 * chunks need to be drawn
+	 */
+	void assembleTriangles(const std::vector<unsigned>& indices);
+	/**
+	 * \brief Turns three transformed vertices into a triangle: discards it if it is outside of the view frustum and clips
+	 * it against the near plane
+	 * \param vertices the indices of the three vertices in the positions of the instance
+	 * \param instance the instance of the draw the triangle belongs to
+	 * \param chunk the chunk the triangle is queued into
+	 */
+	void assembleTriangle(const unsigned* vertices, const DrawInstance& instance, TriangleChunk& chunk);
+	/**
+	 * \brief Performs the perspective division of a triangle in front of the near plane and queues it
+	 * \param triangle the clip space position of the vertices
+	 * \param clipBarycentric the barycentric coordinates of the vertices within the triangle given by the indices, nullptr
+	 * if the triangle wasn't clipped
+	 * \param vertices the indices of the three vertices of the original triangle, whose data is used to shade it
+	 */
+	void submitTriangle(const glm::vec4* triangle, const glm::vec3* clipBarycentric, const unsigned* vertices,
+	                    const DrawInstance& instance, TriangleChunk& chunk);
+
+	/**
+	 * \brief Computes the edge equations and the bounds of a triangle
+	 * \param triangle the vertices of the triangle, after the perspective division
+	 * \param setup the output
+	 * \return false if the triangle doesn't cover any pixel and can be discarded
+	 */
+	bool setupTriangle(const glm::vec3* triangle, TriangleSetup& setup) const;
+
+	/**
+	 * \brief Appends a triangle to the queue of a chunk and to its bins of the tiles it overlaps
+	 */
+	void binTriangle(const TriangleSetup& setup, const unsigned* vertices, const DrawInstance& instance,
+	                 TriangleChunk& chunk);
+	/**
+	 * \brief Draws all of the queued triangles, each thread working on different tiles of the screen
+	 */
+	template <class ShaderT>
+	void flush(ShaderT& shader);
+	/**
+	 * \brief Gets the pixel bounds of a tile, clamped to the screen
+	 */
+	void getTileBounds(int tile, int& minX, int& minY, int& maxX, int& maxY) const;
+	/**
+	 * \brief Empties the chunks once their triangles are drawn
+	 */
+	void clearQueue();
+	/**
+	 * \brief Adds the counters of a thread to the renderer's ones
+	 */
+	void addCounters(const PipelineCounters& threadCounters);
+
+	// The most important function of the whole project, performs all of the computations required to draw on screen.
+	// Only the pixels of the triangle within the given bounds are drawn, stats is the calling thread's counters
+	template <class ShaderT>
+	void processTriangle(ShaderT& shader, const QueuedTriangle& triangle, int minX, int minY, int maxX, int maxY,
+	                     PipelineCounters& stats);
+	/**
+	 * \brief Draws the pixels of a triangle within the given bounds, testing spans of Kernel::WIDTH pixels at once
+	 * \return true if at least one pixel was drawn
+	 */
+	template <class Kernel, class ShaderT>
+	bool rasterize(ShaderT& shader, const QueuedTriangle& triangle, int minX, int minY, int maxX, int maxY,
+	               PipelineCounters& stats);
+	/**
+	 * \brief Same as rasterize(), for depth-only draws: nothing is shaded, only the depth buffer is written
+	 */
+	template <class Kernel>
+	bool rasterize(DepthOnly& shader, const QueuedTriangle& triangle, int minX, int minY, int maxX, int maxY,
+	               PipelineCounters& stats);
+	/**
+	 * \brief Runs the fragment shader of a draw on a run of pixels of a row where its triangles are visible
+	 */
+	template <class ShaderT>
+	void shadeDeferred(ShaderT& shader, int y, int minX, int maxX, PipelineCounters& stats);
+	/**
+	 * \brief Shades the visible pixels within the given bounds, each with the shader of the draw of its triangle. The
+	 * pixels are read once, the neighbouring ones of the same draw going to its shader together
+	 */
+	void shadeTile(int minX, int minY, int maxX, int maxY, PipelineCounters& stats);
+};
+
+template <class ShaderT>
+class Renderer::TypedDeferredDraw : public DeferredDraw
+{
+public:
+	// The shader is copied only if its actual type is ShaderT
+	static constexpr bool COPIES_SHADER = true;
+
+	explicit TypedDeferredDraw(const ShaderT& shader) : shader{ shader } {}
+
+	void shadeRun(Renderer& renderer, int y, int minX, int maxX, PipelineCounters& stats) override
+	{
+		renderer.shadeDeferred(shader, y, minX, maxX, stats);
+	}
+
+private:
+	ShaderT shader;
+};
+
+template <>
+class Renderer::TypedDeferredDraw<ShaderProgram> : public DeferredDraw
+{
+public:
+	// The actual type of the shader is unknown, it can't be copied
+	static constexpr bool COPIES_SHADER = false;
+
+	explicit TypedDeferredDraw(ShaderProgram& shader) : shader{ shader } {}
+
+	void shadeRun(Renderer& renderer, int y, int minX, int maxX, PipelineCounters& stats) override
+	{
+		renderer.shadeDeferred(shader, y, minX, maxX, stats);
+	}
+
+private:
+	ShaderProgram& shader;
 };
+
+template <class ShaderT>
+struct Renderer::InstanceShader
+{
+	static constexpr bool COPIES_SHADER = true;
+
+	explicit InstanceShader(ShaderT& shader) : shader{ shader } {}
+
+	ShaderT shader;
+};
+
+template <>
+struct Renderer::InstanceShader<ShaderProgram>
+{
+	// Shared by all of the batches, which have to run one after the other
+	static constexpr bool COPIES_SHADER = false;
+
+	explicit InstanceShader(ShaderProgram& shader) : shader{ shader } {}
+
+	ShaderProgram& shader;
+};
+
+template <class ShaderT>
+void Renderer::drawIndexed(ShaderT& drawShader, const std::vector<glm::vec3>& vertices, const VertexData& data,
+                           const std::vector<unsigned>& indices)
+{
+	// Calling the functions of ShaderT directly would skip the overrides of the actual type
+	if (!ShaderDispatch<ShaderT>::matches(drawShader))
+	{
+		drawIndexed<ShaderProgram>(drawShader, vertices, data, indices);
+		return;
+	}
+
+	drawShader.beginDraw();
+
+	// Make sure the vertex data has everything the shader needs, fail if it doesn't
+	requireAttributes(drawShader, data, vertices.size());
+
+	// Vertex stage: every vertex is transformed once, no matter how many triangles share it
+	{
+		StageTimer timer{ counters.vertexSeconds, trace, "vertex" };
+
+		transformedVerts.resize(vertices.size());
+		vertexOutputs.resize(vertices.size());
+
+		const int jobCount = static_cast<int>((vertices.size() + VERTEX_CHUNK_SIZE - 1) / VERTEX_CHUNK_SIZE);
+		threads.run(jobCount, [&](int job)
+		{
+			const unsigned begin = job * VERTEX_CHUNK_SIZE;
+			const unsigned end = static_cast<unsigned>(std::min<size_t>(begin + VERTEX_CHUNK_SIZE, vertices.size()));
+
+			PipelineCounters jobCounters;
+			{
+				StageTimer jobTimer{ jobCounters.threadSeconds, trace, "vertex chunk" };
+				runVertexStage(drawShader, vertices, data, begin, end, transformedVerts, vertexOutputs);
+			}
+			addCounters(jobCounters);
+		});
+	}
+
+	drawTransformed(drawShader, data, transformedVerts, vertexOutputs, indices);
+}
+
+template <class ShaderT>
+void Renderer::drawInstanced(ShaderT& drawShader, const std::vector<glm::vec3>& vertices, const VertexData& data,
+                             const std::vector<unsigned>& indices, const std::vector<InstanceUniforms>& instances)
+{
+	if (!ShaderDispatch<ShaderT>::matches(drawShader))
+	{
+		drawInstanced<ShaderProgram>(drawShader, vertices, data, indices, instances);
+		return;
+	}
+
+	if (instances.empty()) return;
+
+	drawShader.beginDraw();
+
+	requireAttributes(drawShader, data, vertices.size());
+
+	const int instanceCount = static_cast<int>(instances.size());
+	if (static_cast<int>(instanceVertices.size()) < instanceCount) instanceVertices.resize(instanceCount);
+
+	// Vertex stage: batches of whole instances, of about as many vertices as the chunks of the other draws
+	{
+		StageTimer timer{ counters.vertexSeconds, trace, "vertex" };
+
+		using InstanceShaderT = InstanceShader<ShaderT>;
+		const int vertexCount = std::max(static_cast<int>(vertices.size()), 1);
+		const int batchSize = InstanceShaderT::COPIES_SHADER ? std::max(VERTEX_CHUNK_SIZE / vertexCount, 1) : instanceCount;
+		const int jobCount = (instanceCount + batchSize - 1) / batchSize;
+		threads.run(jobCount, [&](int job)
+		{
+			PipelineCounters jobCounters;
+			{
+				StageTimer jobTimer{ jobCounters.threadSeconds, trace, "vertex chunk" };
+
+				InstanceShaderT batchShader{ drawShader };
+				const int end = std::min(job * batchSize + batchSize, instanceCount);
+				for (int i = job * batchSize; i < end; i++)
+				{
+					InstanceVertices& output = instanceVertices[i];
+					output.positions.resize(vertices.size());
+					output.outputs.resize(vertices.size());
+
+					batchShader.shader.setDrawUniforms(instances[i].draw);
+					runVertexStage(batchShader.shader, vertices, data, 0, static_cast<unsigned>(vertices.size()),
+					               output.positions, output.outputs);
+				}
+			}
+			addCounters(jobCounters);
+		});
+	}
+
+	// The fragment shader reads the uniforms of the instances until the draw is resolved
+	const InstanceUniforms* uniforms = instances.data();
+	if (deferred)
+	{
+		deferredInstances.push_back(instances);
+		uniforms = deferredInstances.back().data();
+	}
+
+	drawInstances.clear();
+	for (int i = 0; i < instanceCount; i++)
+		drawInstances.push_back({ &instanceVertices[i].positions, &instanceVertices[i].outputs, uniforms + i });
+
+	drawBatch(drawShader, data, indices);
+}
+
+template <class ShaderT>
+void Renderer::drawTransformed(ShaderT& drawShader, const VertexData& data, const std::vector<glm::vec4>& positions,
+                               const VertexOutputs& outputs, const std::vector<unsigned>& indices)
+{
+	drawInstances.assign(1, { &positions, &outputs, nullptr });
+	drawBatch(drawShader, data, indices);
+}
+
+template <class ShaderT>
+void Renderer::drawBatch(ShaderT& drawShader, const VertexData& data, const std::vector<unsigned>& indices)
+{
+	drawData = &data;
+
+	// Primitive assembly and binning
+	{
+		StageTimer timer{ counters.assemblySeconds, trace, "assembly" };
+		assembleTriangles(indices);
+	}
+
+	// The shader's uniforms change from one draw to the next, the triangles have to be drawn before that
+	flush(drawShader);
+	drawData = nullptr;
+	drawInstances.clear();
+
+	if (deferred)
+	{
+		using DeferredDrawT = TypedDeferredDraw<ShaderT>;
+		deferredDraws.emplace_back(new DeferredDrawT{ drawShader });
+
+		// Without a copy, the shader has to be used before its uniforms change
+		if (!DeferredDrawT::COPIES_SHADER) resolve();
+	}
+}
+
+template <class ShaderT>
+void Renderer::flush(ShaderT& drawShader)
+{
+	if (activeTiles.empty()) return;
+
+	StageTimer timer{ counters.rasterSeconds, trace, "raster" };
+
+	/* Every tile owns its own pixels of the framebuffer and of the depth buffer, so tiles can be drawn in parallel without
+	 * any locking. Inside of a tile the triangles are drawn in submission order, so the result is exactly the same as
+	 * drawing them one after the other
+	 */
+	threads.run(static_cast<int>(activeTiles.size()), [this, &drawShader](int job)
+	{
+		const int tile = activeTiles[job];
+		int minX, minY, maxX, maxY;
+		getTileBounds(tile, minX, minY, maxX, maxY);
+
+		// Counted locally, the renderer's counters are shared by all of the threads
+		PipelineCounters tileCounters;
+		{
+			StageTimer tileTimer{ tileCounters.threadSeconds, trace, "raster tile" };
+
+			for (int i = 0; i < chunkCount; i++)
+			{
+				const TriangleChunk& chunk = chunks[i];
+				for (const int index : chunk.bins[tile])
+					processTriangle(drawShader, chunk.queue[index], minX, minY, maxX, maxY, tileCounters);
+			}
+		}
+		addCounters(tileCounters);
+	});
+
+	clearQueue();
+}
+
+template <class ShaderT>
+void Renderer::processTriangle(ShaderT& drawShader, const QueuedTriangle& triangle, int minX, int minY, int maxX,
+                               int maxY, PipelineCounters& stats)
+{
+	const TriangleSetup& setup = triangle.setup;
+
+	// Only the part of the triangle inside of the requested area is drawn
+	minX = std::max(minX, setup.minX);
+	minY = std::max(minY, setup.minY);
+	maxX = std::min(maxX, setup.maxX);
+	maxY = std::min(maxY, setup.maxY);
+	if (minX > maxX || minY > maxY) return;
+
+	// The triangle is drawn one depth buffer block at a time, skipping the blocks where it is entirely hidden
+	constexpr int BLOCK_SIZE = DepthBuffer::BLOCK_SIZE;
+	for (int blockY = minY / BLOCK_SIZE; blockY <= maxY / BLOCK_SIZE; blockY++)
+	{
+		for (int blockX = minX / BLOCK_SIZE; blockX <= maxX / BLOCK_SIZE; blockX++)
+		{
+			if (setup.minZ >= depthBuffer.getBlockMax(blockX, blockY))
+			{
+				FAKEGL_STAT(stats.blocksHidden++);
+				continue;
+			}
+
+			const int blockMinX = std::max(minX, blockX * BLOCK_SIZE);
+			const int blockMinY = std::max(minY, blockY * BLOCK_SIZE);
+			const int blockMaxX = std::min(maxX, blockX * BLOCK_SIZE + BLOCK_SIZE - 1);
+			const int blockMaxY = std::min(maxY, blockY * BLOCK_SIZE + BLOCK_SIZE - 1);
+
+			bool drawn;
+			switch (simdLevel)
+			{
+#ifdef FAKEGL_X86
+			case SimdLevel::AVX2:
+				drawn = rasterize<Avx2Kernel>(drawShader, triangle, blockMinX, blockMinY, blockMaxX, blockMaxY, stats);
+				break;
+			case SimdLevel::SSE2:
+				drawn = rasterize<Sse2Kernel>(drawShader, triangle, blockMinX, blockMinY, blockMaxX, blockMaxY, stats);
+				break;
+#endif
+			default:
+				drawn = rasterize<ScalarKernel>(drawShader, triangle, blockMinX, blockMinY, blockMaxX, blockMaxY, stats);
+				break;
+			}
+
+			// The depths written by the triangle may have lowered the maximum of the block
+			if (drawn) depthBuffer.updateBlock(blockX, blockY);
+		}
+	}
+}
+
+template <class Kernel, class ShaderT>
+bool Renderer::rasterize(ShaderT& drawShader, const QueuedTriangle& triangle, int minX, int minY, int maxX, int maxY,
+                         PipelineCounters& stats)
+{
+	constexpr int WIDTH = Kernel::WIDTH;
+	constexpr unsigned FULL_SPAN = (1u << WIDTH) - 1;
+
+	const TriangleSetup& setup = triangle.setup;
+	PixelSpan<WIDTH> span;
+	bool drawn = false;
+
+	// Spans start at an x multiple of their width, the pixels outside of the bounds are masked off
+	const int startX = minX & ~(WIDTH - 1);
+
+	// Evaluate the edge functions once, at the first pixel of the first span
+	int64_t row[3];
+	for (int i = 0; i < 3; i++)
+		row[i] = setup.stepX[i] * startX + setup.stepY[i] * minY + setup.origin[i];
+
+	// Iterate over the spans of the bounds, row by row to follow the memory layout of the buffers
+	for (int y = minY; y <= maxY; y++)
+	{
+		int64_t w[3] = { row[0], row[1], row[2] };
+		// The rows of the depth buffer are padded, spans never read past the end of a row
+		float* depthRow = depthBuffer.getRow(y);
+
+		for (int x = startX; x <= maxX; x += WIDTH)
+		{
+			unsigned inside = FULL_SPAN;
+			if (x < minX) inside &= FULL_SPAN << (minX - x);
+			if (x + WIDTH - 1 > maxX) inside &= FULL_SPAN >> (x + WIDTH - 1 - maxX);
+
+			// Coverage, barycentric coordinates and depth test of the whole span
+			unsigned mask = Kernel::evaluate(setup, w, depthRow + x, inside, span);
+
+			FAKEGL_STAT(stats.pixelsTested += countBits(inside));
+			FAKEGL_STAT(stats.pixelsCovered += countBits(span.covered));
+			FAKEGL_STAT(stats.depthPassed += countBits(mask));
+			FAKEGL_STAT(stats.depthFailed += countBits(span.covered & ~mask));
+
+			// Gather the pixels that passed, they are shaded together
+			drawn |= mask != 0;
+			const unsigned passed = mask;
+			FragmentBatch fragments;
+			for (int i = 0; i < 3; i++)
+			{
+				for (int lane = 0; lane < WIDTH; lane++)
+					fragments.barycentric[i][lane] = span.barycentric[i][lane];
+			}
+			while (mask != 0)
+			{
+				int lane = 0;
+				while ((mask & 1u << lane) == 0) lane++;
+				mask &= mask - 1;
+
+				// The shaders read the data of the original triangle, the coordinates have to be relative to it
+				if (setup.clipped)
+				{
+					const glm::vec3 barycentric = setup.clipBarycentric[0] * span.barycentric[0][lane] +
+					                              setup.clipBarycentric[1] * span.barycentric[1][lane] +
+					                              setup.clipBarycentric[2] * span.barycentric[2][lane];
+					for (int i = 0; i < 3; i++)
+						fragments.barycentric[i][lane] = barycentric[i];
+				}
+
+				if (deferred)
+				{
+					// Only remember which triangle is visible, resolve() shades it
+					visibility[y * TexWidth + x + lane] = {
+						triangle.deferredIndex,
+						{ fragments.barycentric[0][lane], fragments.barycentric[1][lane], fragments.barycentric[2][lane] }
+					};
+				}
+
+				// Update depth buffer
+				depthRow[x + lane] = span.z[lane];
+			}
+
+			// Get the fragments' colors, then draw!
+			if (!deferred && passed != 0)
+			{
+				fragments.lanes = passed;
+				ofColor colors[FragmentBatch::MAX_SIZE];
+				ShaderDispatch<ShaderT>::runFragmentBatch(drawShader, fragments, triangle.context, simdLevel, colors);
+				FAKEGL_STAT(stats.fragmentsShaded += countBits(passed));
+
+				uint32_t packed[WIDTH];
+				for (int lane = 0; lane < WIDTH; lane++)
+					packed[lane] = RenderTarget::pack(colors[lane]);
+				target->setSpan<WIDTH>(x, y, packed, passed);
+			}
+
+			for (int i = 0; i < 3; i++)
+				w[i] += setup.stepX[i] * WIDTH;
+		}
+
+		for (int i = 0; i < 3; i++)
+			row[i] += setup.stepY[i];
+	}
+
+	return drawn;
+}
+
+template <class ShaderT>
+void Renderer::shadeDeferred(ShaderT& drawShader, int y, int minX, int maxX, PipelineCounters& stats)
+{
+	const VisibilitySample* row = &visibility[y * TexWidth];
+	ofColor colors[FragmentBatch::MAX_SIZE];
+
+	// The neighbouring pixels of the same triangle are shaded together
+	for (int x = minX; x <= maxX;)
+	{
+		const int triangle = row[x].triangle;
+		FragmentBatch fragments{};
+		int count = 0;
+		while (count < FragmentBatch::MAX_SIZE && x + count <= maxX && row[x + count].triangle == triangle)
+		{
+			for (int i = 0; i < 3; i++)
+				fragments.barycentric[i][count] = row[x + count].barycentric[i];
+			count++;
+		}
+		fragments.lanes = (1u << count) - 1;
+
+		ShaderDispatch<ShaderT>::runFragmentBatch(drawShader, fragments, deferredTriangles[triangle], simdLevel, colors);
+		for (int i = 0; i < count; i++)
+			target->setColor(x + i, y, colors[i]);
+		x += count;
+	}
+	FAKEGL_STAT(stats.fragmentsShaded += maxX - minX + 1);
+}
@@ -1,10 +1,71 @@
 ﻿#pragma once
+#include <functional>
+#include <iostream>
 #include <string>
+#include <typeinfo>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/matrix.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 
+#include "ofColor.h"
+#include "RasterKernels.h"
 #include "VertexData.h"
 
+/**
+ * \brief Identifies a uniform of a shader. Looked up once from the name of the uniform with
+ * ShaderProgram::getUniformLocation(), or given as a constant by the shader types
+ */
+using UniformLocation = int;
+constexpr UniformLocation INVALID_UNIFORM = -1;
+
+/**
+ * \brief The uniforms that change with every draw, set all at once by Mesh::render() before drawing
+ */
+struct DrawUniforms
+{
+	// From object space to world space
+	glm::mat4 transform;
+	// The transpose of the inverse of transform, which keeps the normals perpendicular to the surfaces
+	glm::mat4 normalTransform;
+};
+
+/**
+ * \brief What changes from one instance to the next in Renderer::drawInstanced(). The shader receives the draw uniforms
+ * of each instance through setDrawUniforms() before transforming its vertices, and the fragment shader finds them in
+ * TriangleContext::instance
+ */
+struct InstanceUniforms
+{
+	DrawUniforms draw;
+	// Multiplies the colors of the vertices, white leaves them unchanged
+	ofColor color;
+
+	/**
+	 * \brief Computes the normal transform from the transform
+	 */
+	static InstanceUniforms fromTransform(const glm::mat4& transform, ofColor color = { 255, 255 })
+	{
+		return { { transform, glm::transpose(glm::inverse(transform)) }, color };
+	}
+};
+
+/**
+ * \brief Fragments of the same triangle shaded together, one lane per fragment, so that shaders can compute them side by
+ * side. The lanes without a fragment hold valid coordinates too, such as the ones of a pixel of the span outside of the
+ * triangle, so that a shader may compute them along the others and ignore the result
+ */
+struct FragmentBatch
+{
+	static constexpr int MAX_SIZE = 8;
+
+	// The barycentric coordinates of the fragments, one array per vertex of the triangle
+	float barycentric[3][MAX_SIZE];
+	// A bit for every lane holding a fragment
+	unsigned lanes;
+};
+
 /**
  * \brief Generic shader program used by a Renderer object to draw Mesh objects
  */
@@ -12,12 +73,35 @@ class ShaderProgram
 {
 public:
 	/**
-	 * \brief Runs the vertex shader on the given vertex
+	 * \brief Checks that the vertex data of a draw contains every attribute used by the shader. Called once per draw,
+	 * before any vertex is processed. The triangles always load the normals and colors of their vertices, and their
+	 * texture coordinates when there are some (see TriangleContext::load()), so every shader needs those
+	 * \param vertexData the data bound to the vertices
+	 * \param vertexCount the number of vertices of the draw
+	 * \return false if the data can't be used with this shader
+	 */
+	virtual bool validate(const VertexData& vertexData, size_t vertexCount) const
+	{
+		return vertexData.normals.size() >= vertexCount && vertexData.colors.size() >= vertexCount &&
+		       (vertexData.uvs.empty() || vertexData.uvs.size() >= vertexCount);
+	}
+
+	/**
+	 * \brief Called once per draw, before validate(). Shaders update here what they compute from their uniforms or
+	 * from the scene, so that it is done once per draw rather than once per vertex or fragment
+	 */
+	virtual void beginDraw() {}
+
+	/**
+	 * \brief Runs the vertex shader on the given vertex. Large draws transform their vertices on several threads at
+	 * once, the shader must only write the outputs at the given index
 	 * \param vertexPos The position of the vertex
-	 * \param vertexData the data bound to the vertex
+	 * \param vertexData the data bound to the vertices
+	 * \param index the index of the vertex within vertexData
+	 * \param outputs where the values to be interpolated for the fragment shader are stored, at the same index
 	 * \return The final position of the vector, including the perspective divider w
 	 */
-	virtual glm::vec4 runVertexShader(glm::vec3 vertexPos, VertexData* vertexData)
+	virtual glm::vec4 runVertexShader(glm::vec3 vertexPos, const VertexData& vertexData, unsigned index, VertexOutputs& outputs)
 	{
 		return { vertexPos.x, vertexPos.y, vertexPos.z, 1 };
 	}
@@ -25,20 +109,158 @@ public:
 	/**
 	 * \brief runs the fragment shader on a fragment with the given barycentric coords and the surrounding vertices
 	 * \param barycentric The barycentric coordinates of the triangle within its triangle
-	 * \param enclosingVertices the data of the three vertices containing the fragment
+	 * \param triangle the data of the three vertices containing the fragment
 	 * \return the color of the fragment
 	 */
-	virtual ofColor runFragmentShader(glm::vec3 barycentric, std::vector<VertexData*> enclosingVertices)
+	virtual ofColor runFragmentShader(const glm::vec3& barycentric, const TriangleContext& triangle)
 	{
 		return {255, 255, 255, 255};
 	}
 
-	// Variable-setting functions
-	virtual void setUniform4fm(std::string name, glm::mat4 mat) {}
-	virtual void setUniform3fv(std::string name, glm::vec3 vec) {}
-	virtual void setUniform1fv(std::string name, float value) {}
-	virtual void setUniformVec1fv(std::string name, std::vector<float>& vec) {}
-	virtual void setUniformVec3fv(std::string name, std::vector<glm::vec3>& vec) {}
+	/**
+	 * \brief Runs the fragment shader on a batch of fragments of the same triangle. Calls runFragmentShader() on each
+	 * of them, shaders computing several fragments at once override it
+	 * \param fragments the fragments of the batch
+	 * \param triangle the data of the three vertices containing the fragments
+	 * \param simd the instruction set the shader may use
+	 * \param colors where the color of each fragment is written, at the index of its lane
+	 */
+	virtual void runFragmentBatch(const FragmentBatch& fragments, const TriangleContext& triangle, SimdLevel simd,
+	                              ofColor* colors)
+	{
+		for (int lane = 0; lane < FragmentBatch::MAX_SIZE; lane++)
+		{
+			if ((fragments.lanes & 1u << lane) == 0) continue;
+
+			const glm::vec3 barycentric{
+				fragments.barycentric[0][lane], fragments.barycentric[1][lane], fragments.barycentric[2][lane]
+			};
+			colors[lane] = runFragmentShader(barycentric, triangle);
+		}
+	}
+
+	/**
+	 * \return the location of the uniform with the given name, or INVALID_UNIFORM if the shader has no such uniform
+	 */
+	virtual UniformLocation getUniformLocation(const std::string& name) const
+	{
+		return INVALID_UNIFORM;
+	}
+
+	/**
+	 * \brief Sets the uniforms of the next draws which change with every draw
+	 */
+	virtual void setDrawUniforms(const DrawUniforms& uniforms) {}
+
+	// Variable-setting functions. Unknown locations are ignored
+	virtual void setUniform4fm(UniformLocation location, const glm::mat4& mat) {}
+	virtual void setUniform3fv(UniformLocation location, const glm::vec3& vec) {}
+	virtual void setUniform1fv(UniformLocation location, float value) {}
+	virtual void setUniformVec1fv(UniformLocation location, const std::vector<float>& vec) {}
+	virtual void setUniformVec3fv(UniformLocation location, const std::vector<glm::vec3>& vec) {}
+
+	// The same, by name. The name is looked up on every call, prefer the locations for uniforms set often
+	void setUniform4fm(const std::string& name, const glm::mat4& mat) { setUniform4fm(getUniformLocation(name), mat); }
+	void setUniform3fv(const std::string& name, const glm::vec3& vec) { setUniform3fv(getUniformLocation(name), vec); }
+	void setUniform1fv(const std::string& name, float value) { setUniform1fv(getUniformLocation(name), value); }
+	void setUniformVec1fv(const std::string& name, const std::vector<float>& vec)
+	{
+		setUniformVec1fv(getUniformLocation(name), vec);
+	}
+	void setUniformVec3fv(const std::string& name, const std::vector<glm::vec3>& vec)
+	{
+		setUniformVec3fv(getUniformLocation(name), vec);
+	}
 
 	virtual ~ShaderProgram() = default;
 };
+
+/**
+ * \brief Checks that the vertex data of a draw can be used with a shader, with ShaderProgram::validate(), and throws
+ * otherwise
+ */
+inline void requireAttributes(const ShaderProgram& shader, const VertexData& vertexData, size_t vertexCount)
+{
+	if (!shader.validate(vertexData, vertexCount))
+	{
+		std::cerr << "Error, the vertex data is missing attributes required by the shader" << std::endl;
+		throw std::bad_function_call();
+	}
+}
+
+/**
+ * \brief Calls the functions of a shader whose exact type is known at compile time. The calls skip the virtual dispatch,
+ * so that they can be inlined in the rendering loops instantiated for that type
+ */
+template <class ShaderT>
+struct ShaderDispatch
+{
+	/**
+	 * \return true if ShaderT is the actual type of the shader, otherwise skipping the virtual dispatch would call the
+	 * wrong functions
+	 */
+	static bool matches(const ShaderProgram& shader)
+	{
+		return typeid(shader) == typeid(ShaderT);
+	}
+
+	static glm::vec4 runVertexShader(ShaderT& shader, glm::vec3 vertexPos, const VertexData& vertexData, unsigned index,
+	                                 VertexOutputs& outputs)
+	{
+		return shader.ShaderT::runVertexShader(vertexPos, vertexData, index, outputs);
+	}
+
+	static ofColor runFragmentShader(ShaderT& shader, const glm::vec3& barycentric, const TriangleContext& triangle)
+	{
+		return shader.ShaderT::runFragmentShader(barycentric, triangle);
+	}
+
+	static void runFragmentBatch(ShaderT& shader, const FragmentBatch& fragments, const TriangleContext& triangle,
+	                             SimdLevel simd, ofColor* colors)
+	{
+		shader.ShaderT::runFragmentBatch(fragments, triangle, simd, colors);
+	}
+};
+
+/**
+ * \brief Any shader can be used through the base class, at the cost of a virtual call for every vertex and fragment
+ */
+template <>
+struct ShaderDispatch<ShaderProgram>
+{
+	static bool matches(const ShaderProgram& shader)
+	{
+		return true;
+	}
+
+	static glm::vec4 runVertexShader(ShaderProgram& shader, glm::vec3 vertexPos, const VertexData& vertexData,
+	                                 unsigned index, VertexOutputs& outputs)
+	{
+		return shader.runVertexShader(vertexPos, vertexData, index, outputs);
+	}
+
+	static ofColor runFragmentShader(ShaderProgram& shader, const glm::vec3& barycentric, const TriangleContext& triangle)
+	{
+		return shader.runFragmentShader(barycentric, triangle);
+	}
+
+	static void runFragmentBatch(ShaderProgram& shader, const FragmentBatch& fragments, const TriangleContext& triangle,
+	                             SimdLevel simd, ofColor* colors)
+	{
+		shader.runFragmentBatch(fragments, triangle, simd, colors);
+	}
+};
+
+/**
+ * \brief The vertex stage of a draw, or of a chunk of it: runs the vertex shader exactly once on each of the vertices
+ * from begin to end, excluded
+ * \param positions the clip space position of every vertex, already sized for all of the vertices of the draw
+ * \param outputs the other outputs of the vertex shader, sized the same way
+ */
+template <class ShaderT>
+void runVertexStage(ShaderT& shader, const std::vector<glm::vec3>& vertices, const VertexData& data, unsigned begin,
+                    unsigned end, std::vector<glm::vec4>& positions, VertexOutputs& outputs)
+{
+	for (unsigned i = begin; i < end; i++)
+		positions[i] = ShaderDispatch<ShaderT>::runVertexShader(shader, vertices[i], data, i, outputs);
+}
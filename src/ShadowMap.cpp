@@ -0,0 +1,129 @@
+﻿#include "ShadowMap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <glm/trigonometric.hpp>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+
+#include "Bounds.h"
+
+ShadowMap::ShadowMap(int size) : size{ size }
+{
+	for (int face = 0; face < FACE_COUNT; face++)
+	{
+		faces.emplace_back(new DepthBuffer{ size, size });
+		// Until the map is rendered, nothing casts a shadow
+		faces.back()->clear(1000);
+		faceMatrices[face] = glm::mat4{ 1 };
+	}
+}
+
+void ShadowMap::render(Renderer& renderer, const glm::vec3& lightPosition, const std::vector<Mesh*>& casters)
+{
+	static const glm::vec3 directions[FACE_COUNT] = {
+		{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }
+	};
+	// Any up vector orthogonal to the direction would do, the lookups go through the same matrices
+	static const glm::vec3 ups[FACE_COUNT] = {
+		{ 0, 1, 0 }, { 0, 1, 0 }, { 0, 0, 1 }, { 0, 0, 1 }, { 0, 1, 0 }, { 0, 1, 0 }
+	};
+
+	position = lightPosition;
+	const glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, NEAR_PLANE, FAR_PLANE);
+
+	for (int face = 0; face < FACE_COUNT; face++)
+	{
+		faceMatrices[face] = projection * glm::lookAt(position, position + directions[face], ups[face]);
+
+		// A mesh is usually seen by only a few of the faces
+		renderer.clearDepth();
+		const Frustum frustum{ faceMatrices[face] };
+		for (Mesh* mesh : casters)
+		{
+			if (frustum.test(mesh->getWorldBounds()) != Containment::Outside)
+				mesh->renderDepth(renderer, faceMatrices[face]);
+		}
+
+		renderer.swapDepthBuffer(*faces[face]);
+	}
+}
+
+void ShadowMap::setFilterRadius(int radius)
+{
+	filterRadius = std::max(radius, 0);
+}
+
+int ShadowMap::getFilterRadius() const
+{
+	return filterRadius;
+}
+
+void ShadowMap::setBias(float texels)
+{
+	bias = texels;
+}
+
+float ShadowMap::getBias() const
+{
+	return bias;
+}
+
+float ShadowMap::getVisibility(const glm::vec3& fragment, const glm::vec3& normal) const
+{
+	// The fragment is in the face of the axis along which it is the furthest from the light
+	const glm::vec3 offset = fragment - position;
+	const glm::vec3 distance{ std::abs(offset.x), std::abs(offset.y), std::abs(offset.z) };
+	const int axis = distance.x >= distance.y && distance.x >= distance.z ? 0 : distance.y >= distance.z ? 1 : 2;
+	if (distance[axis] == 0) return 1;
+	const int face = 2 * axis + (offset[axis] < 0 ? 1 : 0);
+
+	// A texel of a face is 2 / size wide at a depth of 1, and grows with the depth
+	const float texel = 2 * distance[axis] / size;
+	const glm::vec3 toLight = offset / -glm::length(offset);
+	const glm::vec3 lookup = fragment + (glm::normalize(normal) + toLight) * (texel * bias);
+
+	const glm::vec4 clip = faceMatrices[face] * glm::vec4{ lookup, 1 };
+	if (clip.w <= 0) return 1;
+
+	// The same mapping as the rasterizer, which samples the pixels on integer coordinates. The bias may move the
+	// fragment out of its face, the edge texels are used instead
+	const float depth = clip.z / clip.w;
+	const float maxCoordinate = static_cast<float>(size - 1);
+	const float screenX = std::floor((clip.x / clip.w + 1) * size / 2 + 0.5f);
+	const float screenY = std::floor((clip.y / clip.w + 1) * size / 2 + 0.5f);
+	const int x = static_cast<int>(std::min(std::max(screenX, 0.0f), maxCoordinate));
+	const int y = static_cast<int>(std::min(std::max(screenY, 0.0f), maxCoordinate));
+
+	// Percentage closer filtering: the comparisons are filtered, not the depths
+	const DepthBuffer& buffer = *faces[face];
+	int lit = 0;
+	for (int dy = -filterRadius; dy <= filterRadius; dy++)
+	{
+		const int row = std::min(std::max(y + dy, 0), size - 1);
+		for (int dx = -filterRadius; dx <= filterRadius; dx++)
+		{
+			const int column = std::min(std::max(x + dx, 0), size - 1);
+			if (depth <= buffer.get(column, row)) lit++;
+		}
+	}
+
+	const int side = 2 * filterRadius + 1;
+	return static_cast<float>(lit) / (side * side);
+}
+
+int ShadowMap::getSize() const
+{
+	return size;
+}
+
+const DepthBuffer& ShadowMap::getFace(int face) const
+{
+	return *faces[face];
+}
+
+const glm::mat4& ShadowMap::getFaceMatrix(int face) const
+{
+	return faceMatrices[face];
+}
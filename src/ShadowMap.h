@@ -0,0 +1,79 @@
+﻿#pragma once
+#include <memory>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include "DepthBuffer.h"
+#include "Mesh.h"
+#include "Renderer.h"
+
+/**
+ * \brief What a point light sees around it: the depth of the closest surfaces in each of the six directions of a cube,
+ * each face a DepthBuffer filled by depth-only draws from the position of the light. The shaders look a fragment up in
+ * the face it is in to tell whether another surface stands between it and the light
+ */
+class ShadowMap
+{
+public:
+	// The faces look along +x, -x, +y, -y, +z and -z, in that order
+	static constexpr int FACE_COUNT = 6;
+
+	/**
+	 * \param size the width and height of the faces, in texels
+	 */
+	explicit ShadowMap(int size = 256);
+
+	/**
+	 * \brief Draws the depth of the meshes around a position, replacing the previous content of the faces. The map must
+	 * not be rendered while the shaders reading it are drawing
+	 * \param renderer draws the faces one after the other, its size must be the size of the faces. Its depth buffer is
+	 * exchanged with the faces, and its cull mode applies
+	 * \param position the world space position of the light
+	 * \param casters the meshes casting shadows, usually all of them but the mesh of the light itself
+	 */
+	void render(Renderer& renderer, const glm::vec3& position, const std::vector<Mesh*>& casters);
+
+	/**
+	 * \brief Sets the radius of the percentage closer filtering, in texels: a lookup compares the fragment with the
+	 * (2 * radius + 1)^2 texels around it and keeps the part of them it is in front of, softening the edges of the
+	 * shadows. 0 gives hard shadows, 1 by default
+	 */
+	void setFilterRadius(int radius);
+	int getFilterRadius() const;
+	/**
+	 * \brief Sets how far a fragment is moved towards the light and along its normal before being looked up, in texels
+	 * at its distance from the light. Keeps surfaces from shadowing themselves because of the limited resolution of the
+	 * faces, 1.5 by default
+	 */
+	void setBias(float texels);
+	float getBias() const;
+
+	/**
+	 * \param position the world space position of a fragment
+	 * \param normal the world space normal of the fragment
+	 * \return how much of the light reaches the fragment, from 0 in the shadow to 1 fully lit
+	 */
+	float getVisibility(const glm::vec3& position, const glm::vec3& normal) const;
+
+	int getSize() const;
+	const DepthBuffer& getFace(int face) const;
+	/**
+	 * \return the matrix going from world space to the clip space of a face, its perspective times its view matrix
+	 */
+	const glm::mat4& getFaceMatrix(int face) const;
+
+private:
+	// The depth range of the faces. Nothing closer than about twice NEAR_PLANE is drawn, as the renderer clips at z = 0
+	static constexpr float NEAR_PLANE = 0.05f;
+	static constexpr float FAR_PLANE = 100.0f;
+
+	int size;
+	// Each face takes the place of the depth buffer of the renderer once it is drawn
+	std::vector<std::unique_ptr<DepthBuffer>> faces;
+	glm::mat4 faceMatrices[FACE_COUNT];
+	glm::vec3 position{};
+
+	int filterRadius{ 1 };
+	float bias{ 1.5f };
+};
@@ -7,7 +7,10 @@
 #include "ofUtils.h"
 
 SimpleShader::SimpleShader(glm::mat4 persp, bool lit)
-	: lit{ lit }, perspective{ persp }, lights{} {}
+	: lit{ lit }, perspective{ persp }, lights{}, drawUniforms{ glm::mat4(1), glm::mat4(1) }
+{
+	updateLights();
+}
 
 void SimpleShader::setPersp(glm::mat4 persp) { perspective = persp; }
 
@@ -15,6 +18,7 @@ void SimpleShader::setPersp(glm::mat4 persp) { perspective = persp; }
 void SimpleShader::addLight(Light& light)
 {
 	lights.push_back(light);
+	updateLights();
 }
 
 
@@ -25,136 +29,142 @@ void SimpleShader::removeLight(Light& light)
 		if (&light == &(lights[i].get()))
 		{
 			lights.erase(lights.begin() + i);
+			updateLights();
 			return;
 		}
 	}
 }
 
+void SimpleShader::updateLights()
+{
+	lightGrid = std::make_shared<const LightGrid>(lights);
+}
+
+void SimpleShader::beginDraw()
+{
+	// The lights may have moved since the last draw
+	if (lit && !lightGrid->matches(lights))
+		updateLights();
+}
+
 /*
  * Simply applies world-space transform + perspective and stores the obtained position in the
- * globalPos variable of the vertex data
+ * globalPos output of the vertex
  */
-glm::vec4 SimpleShader::runVertexShader(glm::vec3 vertPos, VertexData* data)
+glm::vec4 SimpleShader::runVertexShader(glm::vec3 vertPos, const VertexData& data, unsigned index, VertexOutputs& outputs)
 {
 	const glm::vec4 vert{ vertPos.x, vertPos.y, vertPos.z, 1 };
 
-	// Uses a custom subtype of VertexData that allows to store local and global vertex position
-	PosVertexData* posData;
-	if ((posData = dynamic_cast<PosVertexData*>(data)) == nullptr)
-	{
-		std::cerr << "Error, simple shader received object that is not PosVertexData";
-		throw std::bad_function_call();
-	}
-
-	posData->localPos = vertPos;
-	posData->globalPos = transform * vert;
-	return perspective * view * posData->globalPos;
+	outputs.localPos[index] = vertPos;
+	outputs.globalPos[index] = drawUniforms.transform * vert;
+	return perspective * view * outputs.globalPos[index];
 }
 
-ofColor SimpleShader::runFragmentShader(glm::vec3 barycentric, std::vector<VertexData*> enclosingVerts)
+UniformLocation SimpleShader::getUniformLocation(const std::string& name) const
 {
-	PosVertexData* posData[3] {};
-
-	// Make sure the vertex data is of the appropriate subtype, fail if it isn't
-	for (int i = 0; i < 3; i++)
-	{
-		if ((posData[i] = dynamic_cast<PosVertexData*>(enclosingVerts[i])) == nullptr)
-		{
-			std::cerr << "Error, simple shader received object that is not PosVertexData";
-			throw std::bad_function_call();
-		}
-	}
-
-	const ofColor baseColor{getColor(barycentric, posData)};
-	ofColor finalColor{ baseColor };
-
-	if (lit) {
-		// Base light pass
-		constexpr float ambient = 0.01f;
-		finalColor *= ambient;
-
-		// Compute and add together every diffuse color from every registered light
-		for (int i = 0; i < lights.size(); i++) {
-			const ofColor diffuse = getDiffuse(barycentric, posData, baseColor, lights[i].get().getMesh().getPosition(),
-			                                   lights[i].get().getIntensity(), lights[i].get().getColor());
-			// Note: ofColor operator+() doesn't add up alpha values, it keeps the alpha of the first operand and clamps the values to prevent overflow
-			// This also means that, with this formula, lights are additive and not multiplicative. It should be relatively easy to change it
-			finalColor += diffuse * 0.5f;
-		}
-	}
+	if (name == "transform") return TRANSFORM;
+	if (name == "view") return VIEW;
 
-	finalColor.a = 255;
+	return INVALID_UNIFORM;
+}
 
-	return finalColor;
+void SimpleShader::setDrawUniforms(const DrawUniforms& uniforms)
+{
+	drawUniforms = uniforms;
 }
 
-void SimpleShader::setUniform4fm(std::string name, glm::mat4 matrix)
+void SimpleShader::setUniform4fm(UniformLocation location, const glm::mat4& matrix)
 {
-	if (name == "transform") {
-		transform = matrix;
-		normalTransform = transpose(inverse(transform));
+	if (location == TRANSFORM) {
+		// The inverse is costly, only compute it when the transform actually changes
+		if (matrix == drawUniforms.transform) return;
+
+		drawUniforms.transform = matrix;
+		drawUniforms.normalTransform = transpose(inverse(matrix));
 	}
 
-	else if (name == "view")
+	else if (location == VIEW)
 		view = matrix;
 }
 
 /**
  * \brief Computes the color of a fragment by averaging the color of the three containing vertices
  * \param barycentric the barycentric coordinates of the fragment
- * \param enclosingVerts the data of the vertices of the enclosing triangle
+ * \param triangle the data of the vertices of the enclosing triangle
  * \return the material color of the fragment
  */
-ofColor SimpleShader::getColor(glm::vec3 barycentric, PosVertexData** enclosingVerts)
+ofColor SimpleShader::getColor(const glm::vec3& barycentric, const TriangleContext& triangle)
 {
 	ofColor color{0, 0, 0, 0};
 
 	for (int i = 0; i < 3; i++)
-		color += enclosingVerts[i]->color * barycentric[i];
+		color += triangle.colors[i] * barycentric[i];
 
 	return color;
 }
 
-/**
- * \brief Compute the diffuse color of the fragment relatively to the given light
- * \param barycentric barycentric coordinates of the fragment within the containing triangle
- * \param enclosingVerts the vertex data of the triangle that contains the fragment
- * \param fragColor the base color of the fragment
- * \param lightPos the position of the light in world space
- * \param lightStrength the strength of the light
- * \return the processed color
- */
-ofColor SimpleShader::getDiffuse(const glm::vec3& barycentric, PosVertexData** enclosingVerts, ofColor fragColor,
-                                 const glm::vec3& lightPos, const float& lightStrength, const ofColor& lightColor)
+void SimpleShader::lightFragments(const FragmentBatch& fragments, const TriangleContext& triangle, SimdLevel simd,
+                                  LitFragments& lighting) const
+{
+	switch (simd)
+	{
+#ifdef FAKEGL_X86
+	case SimdLevel::AVX2:
+		lightFragments<Avx2Lighting>(fragments, triangle, lighting);
+		break;
+	case SimdLevel::SSE2:
+		lightFragments<Sse2Lighting>(fragments, triangle, lighting);
+		break;
+#endif
+	default:
+		lightFragments<ScalarLighting>(fragments, triangle, lighting);
+		break;
+	}
+}
+
+template <class Kernel>
+void SimpleShader::lightFragments(const FragmentBatch& fragments, const TriangleContext& triangle,
+                                  LitFragments& lighting) const
 {
-	static ofColor zero{0, 0, 0, 0};
-
-	// Compute fragment world space pos and normal from the enclosing vertices
-	glm::vec4 fragPos{};
-	glm::vec3 normal{};
-	for (int i = 0; i < 3; i++) {
-		fragPos += enclosingVerts[i]->globalPos * barycentric[i];
-		normal += enclosingVerts[i]->normal * barycentric[i];
+	// Instances of an instanced draw each have their own transform
+	const glm::mat4& normalTransform = triangle.instance ? triangle.instance->draw.normalTransform :
+	                                                       drawUniforms.normalTransform;
+	Kernel::interpolate(fragments, triangle, normalTransform, lighting);
+
+	// Base light pass
+	constexpr float ambient = 0.01f;
+	for (int i = 0; i < 3; i++)
+	{
+		for (int lane = 0; lane < LitFragments::MAX_SIZE; lane++)
+			lighting.color[i][lane] = lighting.base[i][lane] * ambient;
 	}
 
-	normal = normalize(normal);
-	glm::vec4 temp = { normal.x, normal.y, normal.z, 0 };
-	// Apply the rotation to the normal for proper lighting when the mesh is rotated
-	// The normal transform doesn't encode translations/scales, keeps it nice and working!
-	normal = normalTransform * temp;
+	// Only the lights able to reach a fragment are looked at
+	const unsigned* first[FragmentBatch::MAX_SIZE];
+	const unsigned* last[FragmentBatch::MAX_SIZE];
+	for (int lane = 0; lane < FragmentBatch::MAX_SIZE; lane++)
+	{
+		if ((fragments.lanes & 1u << lane) == 0) continue;
 
-	const glm::vec3 spacePos{ fragPos };
-	const glm::vec3 lightOffset{ lightPos - spacePos };
-	const glm::vec3 lightDir{ normalize(lightOffset) };
+		const glm::vec3 position{ lighting.position[0][lane], lighting.position[1][lane], lighting.position[2][lane] };
+		lightGrid->getLights(position, first[lane], last[lane]);
+	}
 
-	// Instead of clamping the dot in the range [0, 1], return when <= 0 to
-	// save some precious CPU time
-	const float dotP = dot(lightDir, normal);
-	if (dotP <= 0) return zero;
+	// Most batches are within a single cell, the others go through the lights of each of their cells in turn
+	unsigned remaining = fragments.lanes;
+	while (remaining != 0)
+	{
+		int lane = 0;
+		while ((remaining & 1u << lane) == 0) lane++;
 
-	// Apply the inverse square law to account for the distance
-	const float dst = pow(length(lightOffset), 0.5f);
+		unsigned cell = 0;
+		for (int other = lane; other < FragmentBatch::MAX_SIZE; other++)
+		{
+			if ((remaining & 1u << other) != 0 && first[other] == first[lane] && last[other] == last[lane])
+				cell |= 1u << other;
+		}
+		remaining &= ~cell;
 
-	// Put it all together
-	return fragColor * lightColor * dotP * (1 / (dst + 0.0001f)) * lightStrength;
-}
\ No newline at end of file
+		Kernel::addLights(lighting, cell, *lightGrid, first[lane], last[lane]);
+	}
+}
@@ -1,9 +1,13 @@
 ﻿#pragma once
+#include <algorithm>
+#include <memory>
 #include <vector>
 #include <glm/fwd.hpp>
 #include <glm/matrix.hpp>
 
 #include "Light.h"
+#include "LightGrid.h"
+#include "LightingKernels.h"
 #include "ofColor.h"
 #include "ShaderProgram.h"
 
@@ -13,11 +17,39 @@
 class SimpleShader: public ShaderProgram
 {
 public:
+	// The locations of the uniforms, derived shaders number theirs from UNIFORM_COUNT
+	enum : UniformLocation
+	{
+		// Also set by setDrawUniforms(), along with the normal transform
+		TRANSFORM,
+		VIEW,
+		UNIFORM_COUNT
+	};
+
 	SimpleShader(glm::mat4 persp, bool lit = true);
 
-	glm::vec4 runVertexShader(glm::vec3 vertexPos, VertexData* vertexData) override;
-	ofColor runFragmentShader(glm::vec3 barycentric, std::vector<VertexData*> containingVertices) override;
-	void setUniform4fm(std::string name, glm::mat4 matrix) override;
+	void beginDraw() override;
+	glm::vec4 runVertexShader(glm::vec3 vertexPos, const VertexData& vertexData, unsigned index, VertexOutputs& outputs) override;
+	ofColor runFragmentShader(const glm::vec3& barycentric, const TriangleContext& triangle) override
+	{
+		return shadeFragment(barycentric, triangle, [this](const glm::vec3& b, const TriangleContext& t)
+		{
+			return SimpleShader::getColor(b, t);
+		});
+	}
+	void runFragmentBatch(const FragmentBatch& fragments, const TriangleContext& triangle, SimdLevel simd,
+	                      ofColor* colors) override
+	{
+		shadeFragments(fragments, triangle, simd, colors, [this](const glm::vec3& b, const TriangleContext& t)
+		{
+			return SimpleShader::getColor(b, t);
+		});
+	}
+	UniformLocation getUniformLocation(const std::string& name) const override;
+	void setDrawUniforms(const DrawUniforms& uniforms) override;
+
+	using ShaderProgram::setUniform4fm;
+	void setUniform4fm(UniformLocation location, const glm::mat4& matrix) override;
 
 	/**
 	 * \brief Track a new light. Uses references to allow updating the position of a light without having to remove it and re-insert it
@@ -30,6 +62,12 @@ public:
 	 */
 	void removeLight(Light& light);
 
+	/**
+	 * \brief Copies the lights and bins them by the space they reach. The fragments only see this copy: beginDraw()
+	 * takes a new one whenever a light has changed since
+	 */
+	void updateLights();
+
 	/**
 	 * \brief Set the perspective matrix used in rendering
 	 * \param persp the matrix
@@ -42,34 +80,116 @@ public:
 	bool lit;
 
 protected:
+	/**
+	 * \brief Computes the final color of a fragment: gets its material color and applies the lighting to it.
+	 * Derived shaders override runFragmentShader() to call this with their own getColor(), so that the call doesn't go
+	 * through the virtual dispatch when the shader is drawn through its own type
+	 * \param barycentric the barycentric coordinates of the fragment
+	 * \param triangle the enclosing vertices' data
+	 * \param getColor a function with the same signature as getColor(), returning the material color
+	 * \return the color of the fragment
+	 */
+	template <class ColorFunction>
+	ofColor shadeFragment(const glm::vec3& barycentric, const TriangleContext& triangle, ColorFunction getColor);
+
+	/**
+	 * \brief The same for a batch of fragments: their material colors are read one at a time, then they are lit side
+	 * by side. Derived shaders override runFragmentBatch() to call this the same way
+	 * \param simd the instruction set used to light the fragments, which gives them the same colors whichever it is
+	 * \param colors where the color of each fragment is written, at the index of its lane
+	 */
+	template <class ColorFunction>
+	void shadeFragments(const FragmentBatch& fragments, const TriangleContext& triangle, SimdLevel simd, ofColor* colors,
+	                    ColorFunction getColor);
+
 	/**
 	 * \brief Get the color of a fragment given the data of its enclosing vertices and its barycentric coordinates
 	 * within said triangle
 	 * \param barycentric the barycentric coordinates
-	 * \param enclosingVerts the enclosing vertices' data
+	 * \param triangle the enclosing vertices' data
 	 * \return the color of the fragment
 	 */
-	virtual ofColor getColor(glm::vec3 barycentric, PosVertexData** enclosingVerts);
+	virtual ofColor getColor(const glm::vec3& barycentric, const TriangleContext& triangle);
 
 private:
 	/**
-	 * \brief get the diffuse color of the given fragment
-	 * \param barycentric the barycentric coordinates of the fragment within it's 3 enclosing vertices
-	 * \param enclosingVerts the vertices of the triangle containing the fragment
-	 * \param color the base color of the fragment
-	 * \param lightPos the position of the light to use
-	 * \param lightStrength the strength of the light to use
-	 * \return the diffuse color of the fragment
+	 * \brief Adds the ambient light and the diffuse light of every light reaching them to the fragments, whose
+	 * material color is already in lighting. The fragments sharing a cell of the light grid go through its lights
+	 * together
 	 */
-	ofColor getDiffuse(const glm::vec3& barycentric, PosVertexData** enclosingVerts, ofColor color, const glm::vec3& lightPos, const float& lightStrength, const ofColor& lightColor);
+	void lightFragments(const FragmentBatch& fragments, const TriangleContext& triangle, SimdLevel simd,
+	                    LitFragments& lighting) const;
+	template <class Kernel>
+	void lightFragments(const FragmentBatch& fragments, const TriangleContext& triangle, LitFragments& lighting) const;
 
 	glm::mat4 perspective;
 	glm::mat4 view;
 
-	// Multiple lights are supported. The fragment shader stage just iterates over all of them and computes the diffuse for each one
+	// Multiple lights are supported. The fragment shader stage iterates over the ones reaching the fragment and computes the diffuse for each one
 	std::vector<std::reference_wrapper<Light>> lights;
+	// Shared by the copies of the shader, updateLights() replaces it instead of modifying it
+	std::shared_ptr<const LightGrid> lightGrid;
 
 	// Uniforms
-	glm::mat4 transform;
-	glm::mat4 normalTransform;
+	DrawUniforms drawUniforms;
 };
+
+template <class ColorFunction>
+ofColor SimpleShader::shadeFragment(const glm::vec3& barycentric, const TriangleContext& triangle, ColorFunction getColor)
+{
+	if (!lit)
+	{
+		ofColor color{ getColor(barycentric, triangle) };
+		color.a = 255;
+		return color;
+	}
+
+	// A batch of a single fragment, lit like the fragments of the larger batches
+	FragmentBatch fragment{};
+	for (int i = 0; i < 3; i++)
+		fragment.barycentric[i][0] = barycentric[i];
+	fragment.lanes = 1;
+
+	ofColor color;
+	shadeFragments(fragment, triangle, SimdLevel::Scalar, &color, getColor);
+	return color;
+}
+
+template <class ColorFunction>
+void SimpleShader::shadeFragments(const FragmentBatch& fragments, const TriangleContext& triangle, SimdLevel simd,
+                                  ofColor* colors, ColorFunction getColor)
+{
+	for (int lane = 0; lane < FragmentBatch::MAX_SIZE; lane++)
+	{
+		if ((fragments.lanes & 1u << lane) == 0) continue;
+
+		const glm::vec3 barycentric{
+			fragments.barycentric[0][lane], fragments.barycentric[1][lane], fragments.barycentric[2][lane]
+		};
+		colors[lane] = getColor(barycentric, triangle);
+		colors[lane].a = 255;
+	}
+
+	if (!lit) return;
+
+	// The kernels may read every lane of a group, the ones without a fragment included
+	LitFragments lighting{};
+	for (int lane = 0; lane < FragmentBatch::MAX_SIZE; lane++)
+	{
+		if ((fragments.lanes & 1u << lane) == 0) continue;
+
+		for (int i = 0; i < 3; i++)
+			lighting.base[i][lane] = colors[lane][i];
+	}
+
+	lightFragments(fragments, triangle, simd, lighting);
+
+	// The light is accumulated as floats, then rounded down once. Lights are additive, the channels saturate
+	for (int lane = 0; lane < FragmentBatch::MAX_SIZE; lane++)
+	{
+		if ((fragments.lanes & 1u << lane) == 0) continue;
+
+		for (int i = 0; i < 3; i++)
+			colors[lane][i] = static_cast<unsigned char>(std::min(std::max(lighting.color[i][lane], 0.0f), 255.0f));
+	}
+}
@@ -0,0 +1,223 @@
+﻿#include "Texture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <glm/common.hpp>
+
+#include "RenderTarget.h"
+
+namespace
+{
+	glm::vec4 unpack(uint32_t texel)
+	{
+		unsigned char bytes[RenderTarget::CHANNELS];
+		std::memcpy(bytes, &texel, sizeof(bytes));
+		return glm::vec4(bytes[0], bytes[1], bytes[2], bytes[3]);
+	}
+
+	ofColor toColor(const glm::vec4& color)
+	{
+		return ofColor(std::round(color.x), std::round(color.y), std::round(color.z), std::round(color.w));
+	}
+}
+
+Texture::Texture(int width, int height, const std::vector<ofColor>& texels)
+{
+	build(width, height, texels);
+}
+
+Texture::Texture(const ofPixels& pixels)
+{
+	const int width = static_cast<int>(pixels.getWidth());
+	const int height = static_cast<int>(pixels.getHeight());
+
+	std::vector<ofColor> colors;
+	colors.reserve(static_cast<size_t>(width) * height);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+			colors.push_back(pixels.getColor(x, y));
+	}
+
+	build(width, height, colors);
+}
+
+void Texture::build(int width, int height, const std::vector<ofColor>& colors)
+{
+	if (width <= 0 || height <= 0 || colors.size() < static_cast<size_t>(width) * height)
+	{
+		std::cerr << "Error, a texture needs width * height texels";
+		throw std::bad_function_call();
+	}
+
+	// Every level is half the size of the previous one, rounded down, until both sides are 1
+	size_t size = 0;
+	for (int w = width, h = height; ; w = std::max(w / 2, 1), h = std::max(h / 2, 1))
+	{
+		const int blocksX = (w + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		const int blocksY = (h + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		levels.push_back({ w, h, blocksX, size });
+		size += static_cast<size_t>(blocksX) * blocksY * BLOCK_SIZE * BLOCK_SIZE;
+
+		if (w == 1 && h == 1) break;
+	}
+
+	// Each level has four times fewer texels than the previous one
+	lodBias = 0.5f * std::log2(static_cast<float>(width) * height);
+
+	storage.assign(size + ALIGNMENT / sizeof(uint32_t), 0);
+	const auto address = reinterpret_cast<uintptr_t>(storage.data());
+	const size_t offset = (ALIGNMENT - address % ALIGNMENT) % ALIGNMENT;
+	texels = storage.data() + offset / sizeof(uint32_t);
+
+	const Level& first = levels.front();
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+			texels[getIndex(first, x, y)] = RenderTarget::pack(colors[static_cast<size_t>(y) * width + x]);
+	}
+
+	// Each texel of a level is the average of the two by two texels it covers in the previous one. The last row and
+	// column of odd sized levels are left out, like most GPUs do
+	for (size_t i = 1; i < levels.size(); i++)
+	{
+		const Level& source = levels[i - 1];
+		const Level& level = levels[i];
+		for (int y = 0; y < level.height; y++)
+		{
+			for (int x = 0; x < level.width; x++)
+			{
+				const int sx = std::min(2 * x + 1, source.width - 1);
+				const int sy = std::min(2 * y + 1, source.height - 1);
+				const glm::vec4 sum = unpack(texels[getIndex(source, 2 * x, 2 * y)]) +
+				                      unpack(texels[getIndex(source, sx, 2 * y)]) +
+				                      unpack(texels[getIndex(source, 2 * x, sy)]) + unpack(texels[getIndex(source, sx, sy)]);
+				texels[getIndex(level, x, y)] = RenderTarget::pack(toColor(sum / 4.0f));
+			}
+		}
+	}
+}
+
+int Texture::getLevelCount() const
+{
+	return static_cast<int>(levels.size());
+}
+
+int Texture::getWidth(int level) const
+{
+	return levels[level].width;
+}
+
+int Texture::getHeight(int level) const
+{
+	return levels[level].height;
+}
+
+void Texture::setFilter(TextureFilter value)
+{
+	filter = value;
+}
+
+TextureFilter Texture::getFilter() const
+{
+	return filter;
+}
+
+void Texture::setWrap(TextureWrap value)
+{
+	wrap = value;
+}
+
+TextureWrap Texture::getWrap() const
+{
+	return wrap;
+}
+
+ofColor Texture::getTexel(int x, int y, int level) const
+{
+	return toColor(unpack(texels[getIndex(levels[level], x, y)]));
+}
+
+ofColor Texture::sample(const glm::vec2& uv, float lod) const
+{
+	const float maxLevel = static_cast<float>(levels.size() - 1);
+	// The negated comparison also gets rid of NaNs
+	lod = !(lod > 0) ? 0 : std::min(lod, maxLevel);
+	const glm::vec2 wrapped{ wrapCoordinate(uv.x), wrapCoordinate(uv.y) };
+
+	switch (filter)
+	{
+	case TextureFilter::Nearest:
+		return toColor(sampleNearest(levels[static_cast<int>(lod + 0.5f)], wrapped));
+	case TextureFilter::Bilinear:
+		return toColor(sampleBilinear(levels[static_cast<int>(lod + 0.5f)], wrapped));
+	default:
+	{
+		const int level = static_cast<int>(lod);
+		const float t = lod - level;
+		const glm::vec4 color = sampleBilinear(levels[level], wrapped);
+		if (t == 0) return toColor(color);
+
+		return toColor(glm::mix(color, sampleBilinear(levels[level + 1], wrapped), t));
+	}
+	}
+}
+
+float Texture::getTriangleLod(const glm::vec2* uvs, float screenArea)
+{
+	// The area of the triangle in texture coordinates, the texels of a texture of a single texel
+	const glm::vec2 a = uvs[1] - uvs[0];
+	const glm::vec2 b = uvs[2] - uvs[0];
+	const float uvArea = std::abs(a.x * b.y - a.y * b.x) * 0.5f;
+
+	// Each level has four times fewer texels than the previous one
+	return 0.5f * std::log2(uvArea / screenArea);
+}
+
+float Texture::wrapCoordinate(float coordinate) const
+{
+	if (wrap == TextureWrap::Repeat)
+		coordinate -= std::floor(coordinate);
+
+	// The negated comparison also gets rid of NaNs, and of the infinities turned into NaNs above
+	return !(coordinate > 0) ? 0 : std::min(coordinate, 1.0f);
+}
+
+int Texture::wrapCoordinate(int coordinate, int size) const
+{
+	if (wrap == TextureWrap::Clamp)
+		return std::min(std::max(coordinate, 0), size - 1);
+
+	const int wrapped = coordinate % size;
+	return wrapped < 0 ? wrapped + size : wrapped;
+}
+
+glm::vec4 Texture::fetch(const Level& level, int x, int y) const
+{
+	return unpack(texels[getIndex(level, wrapCoordinate(x, level.width), wrapCoordinate(y, level.height))]);
+}
+
+glm::vec4 Texture::sampleNearest(const Level& level, const glm::vec2& uv) const
+{
+	return fetch(level, static_cast<int>(std::floor(uv.x * level.width)), static_cast<int>(std::floor(uv.y * level.height)));
+}
+
+glm::vec4 Texture::sampleBilinear(const Level& level, const glm::vec2& uv) const
+{
+	// Texel centers are at half coordinates
+	const float x = uv.x * level.width - 0.5f;
+	const float y = uv.y * level.height - 0.5f;
+	const float floorX = std::floor(x);
+	const float floorY = std::floor(y);
+	const float tx = x - floorX;
+	const float ty = y - floorY;
+	const int x0 = static_cast<int>(floorX);
+	const int y0 = static_cast<int>(floorY);
+
+	const glm::vec4 top = glm::mix(fetch(level, x0, y0), fetch(level, x0 + 1, y0), tx);
+	const glm::vec4 bottom = glm::mix(fetch(level, x0, y0 + 1), fetch(level, x0 + 1, y0 + 1), tx);
+	return glm::mix(top, bottom, ty);
+}
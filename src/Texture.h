@@ -0,0 +1,158 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+#include "ofColor.h"
+#include "ofPixels.h"
+
+/**
+ * \brief How the texels around a texture coordinate are combined
+ */
+enum class TextureFilter
+{
+	// The closest texel of the closest mipmap level
+	Nearest,
+	// The four closest texels of the closest mipmap level, weighted by their distance
+	Bilinear,
+	// Bilinear in the two closest mipmap levels, then blended between them
+	Trilinear
+};
+
+/**
+ * \brief What the texture coordinates outside of [0, 1] read
+ */
+enum class TextureWrap
+{
+	Repeat,
+	Clamp
+};
+
+/**
+ * \brief An RGBA image read by the shaders, along with its mipmaps: the same image halved again and again down to a
+ * single texel, so that triangles far away read a small level instead of skipping over most of the texels.
+ * The texels aren't stored row by row but in square blocks of BLOCK_SIZE texels, each block filling exactly one cache
+ * line. The texels read for neighbouring fragments, and the four read by a bilinear fetch, are close to each other in
+ * both directions, so they are most often found in the same few cache lines
+ */
+class Texture
+{
+public:
+	// The side of the blocks, a block of 32 bits texels is 64 bytes
+	static constexpr int BLOCK_SIZE = 4;
+	// The alignment of the texels, in bytes: the blocks start on a cache line
+	static constexpr int ALIGNMENT = 64;
+
+	/**
+	 * \param texels width * height colors, row by row starting from the top
+	 */
+	Texture(int width, int height, const std::vector<ofColor>& texels);
+	/**
+	 * \brief Copies the pixels of an image, for instance the ones of an ofImage loaded from a file
+	 */
+	explicit Texture(const ofPixels& pixels);
+	// texels points into storage, a copy would keep reading the texels of the original
+	Texture(const Texture&) = delete;
+	void operator=(const Texture&) = delete;
+
+	/**
+	 * \return the number of mipmap levels, the first one being the texture itself
+	 */
+	int getLevelCount() const;
+	int getWidth(int level = 0) const;
+	int getHeight(int level = 0) const;
+
+	void setFilter(TextureFilter filter);
+	TextureFilter getFilter() const;
+	void setWrap(TextureWrap wrap);
+	TextureWrap getWrap() const;
+
+	/**
+	 * \return the texel at the given coordinates, which must be within the level
+	 */
+	ofColor getTexel(int x, int y, int level = 0) const;
+
+	/**
+	 * \brief Reads the texture with its filter and wrap mode
+	 * \param uv the texture coordinates, (0, 0) is the top left corner of the image and (1, 1) the bottom right one
+	 * \param lod the mipmap level to read, between two levels when it isn't an integer. See getLod()
+	 */
+	ofColor sample(const glm::vec2& uv, float lod = 0) const;
+
+	/**
+	 * \brief Computes the mipmap level matching the size of a triangle on screen in a texture of a single texel: the
+	 * level where a pixel covers about a texel, minus the levels of the texture. The rasterizer interpolates the texture
+	 * coordinates linearly on screen, so the level is the same for every fragment of a triangle and is computed once per
+	 * triangle, whichever texture it reads
+	 * \param uvs the texture coordinates of the three vertices of the triangle
+	 * \param screenArea the area of the triangle on screen, in pixels
+	 */
+	static float getTriangleLod(const glm::vec2* uvs, float screenArea);
+	/**
+	 * \return the mipmap level of this texture read by a triangle, from its getTriangleLod()
+	 */
+	float getLod(float triangleLod) const
+	{
+		return triangleLod + lodBias;
+	}
+
+private:
+	/**
+	 * \brief Where a mipmap level is in texels. Its size is rounded up to whole blocks
+	 */
+	struct Level
+	{
+		int width;
+		int height;
+		// The number of blocks in a row of blocks
+		int blocksX;
+		// The index of the first texel of the level
+		size_t offset;
+	};
+
+	std::vector<Level> levels;
+	// Allocated with room to spare, texels points at its first aligned element. Every level packs its texels like
+	// RenderTarget does
+	std::vector<uint32_t> storage;
+	uint32_t* texels;
+
+	// The levels above a texture of a single texel: half the log2 of the texels of the first level
+	float lodBias;
+
+	TextureFilter filter{ TextureFilter::Bilinear };
+	TextureWrap wrap{ TextureWrap::Repeat };
+
+	/**
+	 * \brief Allocates the levels and fills them from the first one, given row by row
+	 */
+	void build(int width, int height, const std::vector<ofColor>& texels);
+
+	/**
+	 * \return the index of a texel of a level in texels
+	 */
+	static size_t getIndex(const Level& level, int x, int y)
+	{
+		// Blocks follow each other row by row, and so do the texels of a block
+		const unsigned ux = static_cast<unsigned>(x), uy = static_cast<unsigned>(y);
+		const unsigned block = (uy / BLOCK_SIZE) * level.blocksX + ux / BLOCK_SIZE;
+		return level.offset + block * BLOCK_SIZE * BLOCK_SIZE + (uy % BLOCK_SIZE) * BLOCK_SIZE + ux % BLOCK_SIZE;
+	}
+
+	/**
+	 * \brief Maps a texture coordinate within [0, 1] depending on the wrap mode, before it is turned into texels. Huge
+	 * coordinates and NaNs wouldn't fit in an int
+	 */
+	float wrapCoordinate(float coordinate) const;
+	/**
+	 * \brief Maps a texel coordinate outside of a level back inside of it, depending on the wrap mode
+	 */
+	int wrapCoordinate(int coordinate, int size) const;
+	/**
+	 * \return the texel as four floats in [0, 255], with its coordinates wrapped
+	 */
+	glm::vec4 fetch(const Level& level, int x, int y) const;
+
+	glm::vec4 sampleNearest(const Level& level, const glm::vec2& uv) const;
+	glm::vec4 sampleBilinear(const Level& level, const glm::vec2& uv) const;
+};
@@ -0,0 +1,31 @@
+﻿#include "TexturedShader.h"
+
+TexturedShader::TexturedShader(glm::mat4 persp, bool lit)
+	: SimpleShader(persp, lit) {}
+
+bool TexturedShader::validate(const VertexData& vertexData, size_t vertexCount) const
+{
+	return SimpleShader::validate(vertexData, vertexCount) && vertexData.uvs.size() >= vertexCount;
+}
+
+void TexturedShader::setTexture(const Texture* value)
+{
+	texture = value;
+}
+
+const Texture* TexturedShader::getTexture() const
+{
+	return texture;
+}
+
+ofColor TexturedShader::getColor(const glm::vec3& barycentric, const TriangleContext& triangle)
+{
+	const ofColor color = SimpleShader::getColor(barycentric, triangle);
+	if (texture == nullptr) return color;
+
+	glm::vec2 uv{};
+	for (int i = 0; i < 3; i++)
+		uv += triangle.uvs[i] * barycentric[i];
+
+	return texture->sample(uv, texture->getLod(triangle.uvLod)) * color;
+}
@@ -0,0 +1,44 @@
+﻿#pragma once
+#include "SimpleShader.h"
+#include "Texture.h"
+
+/**
+ * \brief Variation of the lit shader, multiplies the color of the vertices by a texture read at their texture
+ * coordinates. The vertex data must have texture coordinates
+ */
+class TexturedShader : public SimpleShader
+{
+public:
+	TexturedShader(glm::mat4 persp, bool lit = true);
+
+	bool validate(const VertexData& vertexData, size_t vertexCount) const override;
+
+	ofColor runFragmentShader(const glm::vec3& barycentric, const TriangleContext& triangle) override
+	{
+		return shadeFragment(barycentric, triangle, [this](const glm::vec3& b, const TriangleContext& t)
+		{
+			return TexturedShader::getColor(b, t);
+		});
+	}
+	void runFragmentBatch(const FragmentBatch& fragments, const TriangleContext& triangle, SimdLevel simd,
+	                      ofColor* colors) override
+	{
+		shadeFragments(fragments, triangle, simd, colors, [this](const glm::vec3& b, const TriangleContext& t)
+		{
+			return TexturedShader::getColor(b, t);
+		});
+	}
+
+	/**
+	 * \brief Sets the texture of the next draws, nullptr to only use the colors of the vertices. The texture isn't
+	 * copied along with the shader, it must outlive the draws, including the deferred and recorded ones
+	 */
+	void setTexture(const Texture* texture);
+	const Texture* getTexture() const;
+
+protected:
+	ofColor getColor(const glm::vec3& barycentric, const TriangleContext& triangle) override;
+
+private:
+	const Texture* texture{ nullptr };
+};
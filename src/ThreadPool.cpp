@@ -0,0 +1,272 @@
+﻿#include "ThreadPool.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+	uint64_t packRange(uint32_t begin, uint32_t end)
+	{
+		return static_cast<uint64_t>(end) << 32 | begin;
+	}
+
+	uint32_t rangeBegin(uint64_t range)
+	{
+		return static_cast<uint32_t>(range);
+	}
+
+	uint32_t rangeEnd(uint64_t range)
+	{
+		return static_cast<uint32_t>(range >> 32);
+	}
+
+	// The pool the current thread works for, and its range in the batches of that pool
+	thread_local const ThreadPool* currentPool{ nullptr };
+	thread_local unsigned currentThread{ 0 };
+
+	/**
+	 * \brief Keeps the thread on the given core, so that it doesn't lose its caches by moving from one to another.
+	 * Does nothing on the platforms where it isn't supported
+	 */
+	void pinThread(std::thread& thread, unsigned core)
+	{
+#ifdef _WIN32
+		SetThreadAffinityMask(thread.native_handle(), DWORD_PTR{ 1 } << core);
+#elif defined(__linux__)
+		cpu_set_t cores;
+		CPU_ZERO(&cores);
+		CPU_SET(core, &cores);
+		pthread_setaffinity_np(thread.native_handle(), sizeof(cores), &cores);
+#endif
+	}
+}
+
+ThreadPool::ThreadPool(unsigned threadCount, bool pinThreads)
+{
+	// hardware_concurrency() is allowed to return 0, the calling thread always works anyway
+	const unsigned workerCount = std::max(threadCount, 1u) - 1;
+	const unsigned coreCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	workers.reserve(workerCount);
+	for (unsigned i = 0; i < workerCount; i++)
+	{
+		workers.emplace_back(&ThreadPool::workerLoop, this, i + 1);
+		if (pinThreads) pinThread(workers.back(), (i + 1) % coreCount);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		stopping = true;
+	}
+	workReady.notify_all();
+
+	for (auto& worker : workers)
+		worker.join();
+}
+
+unsigned ThreadPool::size() const
+{
+	return static_cast<unsigned>(workers.size()) + 1;
+}
+
+void ThreadPool::run(int count, const std::function<void(int)>& batchJob)
+{
+	if (count <= 0) return;
+
+	// Not worth waking anyone up for a single job
+	if (count == 1 || workers.empty())
+	{
+		for (int i = 0; i < count; i++)
+			batchJob(i);
+		return;
+	}
+
+	// Split the jobs in contiguous ranges of about the same size
+	const unsigned threadCount = size();
+	Batch batch{ &batchJob, std::unique_ptr<JobRange[]>{ new JobRange[threadCount] }, 1 };
+	for (unsigned i = 0; i < threadCount; i++)
+	{
+		const uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(count) * i / threadCount);
+		const uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(count) * (i + 1) / threadCount);
+		batch.ranges[i].bounds = packRange(begin, end);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		openBatches.push_back(&batch);
+	}
+	workReady.notify_all();
+
+	work(batch, getThreadIndex());
+
+	// Wait for the other threads to finish their last jobs, the batch can't be released before that
+	std::unique_lock<std::mutex> lock{ mutex };
+	openBatches.erase(std::remove(openBatches.begin(), openBatches.end(), &batch), openBatches.end());
+	batch.busyThreads--;
+	batchDone.wait(lock, [&batch] { return batch.busyThreads == 0; });
+}
+
+void ThreadPool::spawn(Fence& fence, std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		fence.pending++;
+		tasks.push_back({ std::move(task), &fence });
+	}
+	workReady.notify_one();
+}
+
+void ThreadPool::wait(Fence& fence)
+{
+	const unsigned thread = getThreadIndex();
+
+	std::unique_lock<std::mutex> lock{ mutex };
+	while (fence.pending != 0)
+	{
+		// The tasks of the fence nobody started are run right away, which is also what runs them without workers
+		const auto task = std::find_if(tasks.begin(), tasks.end(), [&fence](const Task& t) { return t.fence == &fence; });
+		if (task != tasks.end())
+		{
+			Task taken = std::move(*task);
+			tasks.erase(task);
+			runTask(lock, std::move(taken));
+		}
+		else if (!openBatches.empty())
+			joinBatch(lock, thread);
+		else
+			workReady.wait(lock);
+	}
+
+	// Reset, so that the fence can be used again
+	const std::exception_ptr error = fence.error;
+	fence.error = nullptr;
+	lock.unlock();
+
+	if (error) std::rethrow_exception(error);
+}
+
+unsigned ThreadPool::getThreadIndex() const
+{
+	return currentPool == this ? currentThread : 0;
+}
+
+void ThreadPool::joinBatch(std::unique_lock<std::mutex>& lock, unsigned thread)
+{
+	Batch& batch = *openBatches.front();
+	batch.busyThreads++;
+	lock.unlock();
+
+	work(batch, thread);
+
+	lock.lock();
+	// Every job has been started, the other threads have nothing left to do in the batch
+	openBatches.erase(std::remove(openBatches.begin(), openBatches.end(), &batch), openBatches.end());
+	if (--batch.busyThreads == 0)
+		batchDone.notify_all();
+}
+
+void ThreadPool::runTask(std::unique_lock<std::mutex>& lock, Task task)
+{
+	lock.unlock();
+
+	std::exception_ptr error;
+	try
+	{
+		task.run();
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+
+	lock.lock();
+	if (error && !task.fence->error) task.fence->error = error;
+	task.fence->pending--;
+	// The threads waiting for the fence sleep on workReady
+	workReady.notify_all();
+}
+
+void ThreadPool::work(Batch& batch, unsigned thread)
+{
+	do
+	{
+		int index;
+		while (pop(batch, thread, index))
+			(*batch.job)(index);
+	} while (steal(batch, thread));
+}
+
+bool ThreadPool::pop(Batch& batch, unsigned thread, int& index)
+{
+	std::atomic<uint64_t>& bounds = batch.ranges[thread].bounds;
+
+	uint64_t range = bounds.load();
+	do
+	{
+		if (rangeBegin(range) >= rangeEnd(range)) return false;
+	} while (!bounds.compare_exchange_weak(range, packRange(rangeBegin(range) + 1, rangeEnd(range))));
+
+	index = static_cast<int>(rangeBegin(range));
+	return true;
+}
+
+bool ThreadPool::steal(Batch& batch, unsigned thread)
+{
+	const unsigned threadCount = size();
+
+	// Start from the next thread, so that the thieves don't all pick the same victim
+	for (unsigned i = 1; i < threadCount; i++)
+	{
+		std::atomic<uint64_t>& victim = batch.ranges[(thread + i) % threadCount].bounds;
+
+		uint64_t range = victim.load();
+		while (rangeBegin(range) < rangeEnd(range))
+		{
+			// The victim keeps the first half, rounded down, as it is already working on its first job
+			const uint32_t middle = rangeBegin(range) + (rangeEnd(range) - rangeBegin(range)) / 2;
+			if (victim.compare_exchange_weak(range, packRange(rangeBegin(range), middle)))
+			{
+				// The thread's own range is empty, no other thread writes to it
+				batch.ranges[thread].bounds = packRange(middle, rangeEnd(range));
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::workerLoop(unsigned thread)
+{
+	currentPool = this;
+	currentThread = thread;
+
+	std::unique_lock<std::mutex> lock{ mutex };
+	while (true)
+	{
+		workReady.wait(lock, [this] { return stopping || !openBatches.empty() || !tasks.empty(); });
+		if (stopping) return;
+
+		// The batches first, a thread is waiting for each of them
+		if (!openBatches.empty())
+			joinBatch(lock, thread);
+		else
+		{
+			Task task = std::move(tasks.front());
+			tasks.pop_front();
+			runTask(lock, std::move(task));
+		}
+	}
+}
@@ -0,0 +1,142 @@
+﻿#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief A set of persistent worker threads that split batches of independent jobs between themselves.
+ * Every thread starts with its own contiguous range of the jobs, so neighbouring jobs, such as adjacent screen tiles,
+ * tend to run on the same thread. A thread done with its range steals half of what is left of another one's, so no
+ * thread sits idle while one of them has a long job. Each batch completes before run() returns: the renderer's stages
+ * are batches submitted one after the other, so a stage always sees the whole output of the previous one.
+ * The pool also runs tasks that nobody waits for right away, such as a whole frame of commands. The workers only pick
+ * them up when no batch needs them, and a task may run batches of its own, so everything shares the same threads
+ */
+class ThreadPool
+{
+public:
+	/**
+	 * \brief Counts the tasks started with it that aren't done yet, wait() blocks until there are none. It must not be
+	 * destroyed before its tasks are done
+	 */
+	class Fence
+	{
+	public:
+		Fence() = default;
+		Fence(const Fence&) = delete;
+		void operator=(const Fence&) = delete;
+
+	private:
+		friend class ThreadPool;
+
+		// Guarded by the mutex of the pool
+		unsigned pending{ 0 };
+		// The first error thrown by one of the tasks
+		std::exception_ptr error;
+	};
+
+	/**
+	 * \param threadCount the total number of threads working on a batch, including the one calling run()
+	 * \param pinThreads true to bind each worker thread to its own core, leaving the first core to the calling thread
+	 */
+	explicit ThreadPool(unsigned threadCount = std::thread::hardware_concurrency(), bool pinThreads = false);
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool(ThreadPool&&) = delete;
+
+	void operator=(const ThreadPool&) = delete;
+	void operator=(ThreadPool&&) = delete;
+
+	/**
+	 * \brief Runs job(0) ... job(jobCount - 1) spread over all the threads, returns when all of them are done.
+	 * The calling thread works on the batch as well. Batches run at the same time are shared between the threads, but
+	 * only the worker threads and one other thread at a time may call run()
+	 */
+	void run(int jobCount, const std::function<void(int)>& job);
+
+	/**
+	 * \brief Queues a task for one of the worker threads and returns right away
+	 * \param fence counts the task until it is done
+	 */
+	void spawn(Fence& fence, std::function<void()> task);
+	/**
+	 * \brief Blocks until every task of the fence is done, then throws the first error one of them met. Meanwhile the
+	 * calling thread runs the tasks of the fence nobody started yet, and works on the batches, so that it isn't idle
+	 */
+	void wait(Fence& fence);
+
+	/**
+	 * \return the number of threads working on a batch, including the calling one
+	 */
+	unsigned size() const;
+
+	~ThreadPool();
+private:
+	/**
+	 * \brief The jobs left to a thread, begin in the low 32 bits and end in the high ones, so that both are updated by a
+	 * single compare and swap. Padded to the size of a cache line, as it is written on every job
+	 */
+	struct JobRange
+	{
+		std::atomic<uint64_t> bounds{ 0 };
+		char padding[64 - sizeof(std::atomic<uint64_t>)];
+	};
+
+	/**
+	 * \brief The jobs of a run() call, which lives as long as the call
+	 */
+	struct Batch
+	{
+		const std::function<void(int)>* job;
+		// One for each thread, the range of the threads that aren't workers first
+		std::unique_ptr<JobRange[]> ranges;
+		// The threads working on the batch, guarded by the mutex. The batch is done once they have all left
+		unsigned busyThreads;
+	};
+
+	struct Task
+	{
+		std::function<void()> run;
+		Fence* fence;
+	};
+
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	// Notified when a batch or a task is available, when a task is done, or when the pool is being destroyed
+	std::condition_variable workReady;
+	// Notified when the last thread leaves a batch
+	std::condition_variable batchDone;
+
+	// The batches whose jobs haven't all been started yet
+	std::vector<Batch*> openBatches;
+	// The tasks no thread started yet, oldest first
+	std::deque<Task> tasks;
+	bool stopping{ false };
+
+	void workerLoop(unsigned thread);
+	/**
+	 * \return the range the calling thread takes in the batches, its own one if it is a worker of this pool
+	 */
+	unsigned getThreadIndex() const;
+	/**
+	 * \brief Joins the first open batch and works on it until all of its jobs are started. The lock is released meanwhile
+	 */
+	void joinBatch(std::unique_lock<std::mutex>& lock, unsigned thread);
+	/**
+	 * \brief Runs a task taken out of the queue and counts it as done. The lock is released meanwhile
+	 */
+	void runTask(std::unique_lock<std::mutex>& lock, Task task);
+	// Run the jobs of the given thread's range, then the ones stolen from the other threads, until there are none left
+	void work(Batch& batch, unsigned thread);
+	// Take the first job of a thread's range, false if the range is empty
+	bool pop(Batch& batch, unsigned thread, int& index);
+	// Move the second half of another thread's range into the given thread's one, false if every range is empty
+	bool steal(Batch& batch, unsigned thread);
+};
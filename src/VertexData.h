@@ -1,29 +1,106 @@
 ﻿#pragma once
+#include <algorithm>
+#include <vector>
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 
+#include "ofColor.h"
+
+struct InstanceUniforms;
+
 /**
- * \brief Stores basic data of a vertex
+ * \brief Stores the data bound to the vertices of a mesh. Every attribute is kept in its own contiguous array, the i-th
+ * element of each array belongs to the i-th vertex
  */
-class VertexData
+struct VertexData
 {
-public:
-	glm::vec3 normal;
-	ofColor color;
+	std::vector<glm::vec3> normals;
+	std::vector<ofColor> colors;
+	// The texture coordinates, optional: either empty or one for every vertex
+	std::vector<glm::vec2> uvs;
+
+	/**
+	 * \return the number of vertices with a complete set of the required attributes
+	 */
+	size_t size() const
+	{
+		return std::min(normals.size(), colors.size());
+	}
 
-	VertexData(glm::vec3 norm, ofColor col) : normal{ norm }, color{ col } {}
+	/**
+	 * \brief Appends the attributes of the index-th vertex of other
+	 */
+	void push_back(const VertexData& other, size_t index)
+	{
+		normals.push_back(other.normals[index]);
+		colors.push_back(other.colors[index]);
+		if (!other.uvs.empty()) uvs.push_back(other.uvs[index]);
+	}
 
-	virtual ~VertexData() = default;
+	void reserve(size_t count)
+	{
+		normals.reserve(count);
+		colors.reserve(count);
+		uvs.reserve(count);
+	}
 };
 
 /**
- * \brief Stores basic + positional data of a vertex
+ * \brief Stores the values computed by the vertex shader for every vertex of a draw, they are interpolated and read by
+ * the fragment shader. Uses the same layout as VertexData
  */
-class PosVertexData : public VertexData
+struct VertexOutputs
 {
-public:
-	glm::vec3 localPos;
-	glm::vec4 globalPos;
+	// Position of the vertex in object space
+	std::vector<glm::vec3> localPos;
+	// Position of the vertex in world space
+	std::vector<glm::vec4> globalPos;
 
-	PosVertexData(glm::vec3 norm, ofColor col, glm::vec3 locPos) : VertexData(norm, col), localPos{ locPos }, globalPos{} {}
-};
\ No newline at end of file
+	void resize(size_t count)
+	{
+		localPos.resize(count);
+		globalPos.resize(count);
+	}
+};
+
+/**
+ * \brief The data of the three vertices of a triangle, gathered once per triangle so that shading its fragments doesn't
+ * have to look anything up
+ */
+struct TriangleContext
+{
+	glm::vec3 normals[3];
+	ofColor colors[3];
+	glm::vec3 localPos[3];
+	glm::vec4 globalPos[3];
+	// Only loaded when the vertex data has texture coordinates
+	glm::vec2 uvs[3];
+	// The mipmap level the triangle reads in a texture of a single texel, computed once when the triangle is set up. See
+	// Texture::getTriangleLod(), only computed when the vertex data has texture coordinates
+	float uvLod;
+	// The instance the triangle belongs to in instanced draws, nullptr otherwise
+	const InstanceUniforms* instance{ nullptr };
+
+	/**
+	 * \brief Copies the data of the given vertices. The attributes aren't checked here, the data of the draw has been
+	 * accepted by ShaderProgram::validate()
+	 * \param vertices the indices of the three vertices of the triangle
+	 */
+	void load(const unsigned* vertices, const VertexData& data, const VertexOutputs& outputs)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			normals[i] = data.normals[vertices[i]];
+			colors[i] = data.colors[vertices[i]];
+			localPos[i] = outputs.localPos[vertices[i]];
+			globalPos[i] = outputs.globalPos[vertices[i]];
+		}
+
+		if (!data.uvs.empty())
+		{
+			for (int i = 0; i < 3; i++)
+				uvs[i] = data.uvs[vertices[i]];
+		}
+	}
+};
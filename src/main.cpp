@@ -1,7 +1,38 @@
+#include <iostream>
+
+#include "Benchmark.h"
+#include "Headless.h"
 #include "ofApp.h"
 #include "ofMain.h"
 
-int main( ){
+int main(int argc, char** argv){
+	// Render without a window, see Headless.h
+	if (isHeadless(argc, argv))
+	{
+		HeadlessOptions options;
+		if (!parseHeadlessOptions(argc, argv, options))
+		{
+			std::cerr << "Usage: " << argv[0] << " --headless [--frames N] [--size WxH] [--threads N] "
+				"[--frame-time SECONDS] [--out DIR] [--stats] [--trace FILE] [--pin-threads]" << std::endl;
+			return 1;
+		}
+
+		return runHeadless(options);
+	}
+
+	// Measure the renderer on fixed scenes, see Benchmark.h
+	if (isBenchmark(argc, argv))
+	{
+		BenchmarkOptions options;
+		if (!parseBenchmarkOptions(argc, argv, options))
+		{
+			std::cerr << "Usage: " << argv[0] << " --bench [--quick] [--threads N]" << std::endl;
+			return 1;
+		}
+
+		return runBenchmark(options);
+	}
+
 	ofSetupOpenGL(1024,768,OF_WINDOW);
 	
 	ofRunApp(new ofApp());
@@ -1,65 +1,33 @@
 #include "ofApp.h"
 
 #include "Camera.h"
-#include "Mesh.h"
+#include "CommandBuffer.h"
+#include "DemoScene.h"
+#include "Presenter.h"
 #include "Renderer.h"
-#include "SimpleShader.h"
-#include "CubeGen.h"
-#include "OutlineShader.h"
-#include "RainbowShader.h"
 #include "GLFW/glfw3.h"
 
 int width = 1000;
 int height = 800;
 
 void updateInput();
-glm::mat4 getPerspective();
 
+// Declared first so that it is destroyed last, the buffers wait for the commands that still use the scene and them
 Renderer renderer{};
-glm::mat4 persp = getPerspective();
-SimpleShader shader{ persp, true };
-Mesh cube{ generateCube({}, {1, 1, 1}, {255, 255, 255}) };
-
-Mesh pyramid{ generatePyramid({2.5, 0, 0}, {1, 1, 1}, {120, 50, 130}) };
-
-SimpleShader unlit{ persp, false };
-Mesh lightMesh{ generateCube({1.25, .5, 1}, glm::vec3{0.2f}, {255, 100, 10})};
-Light light{ lightMesh, 2, {255, 100, 10} };
-
-Mesh lightMesh2{ generateCube({1.25, -.5, -1}, glm::vec3{0.2f}, {0, 150, 255}) };
-Light light2{ lightMesh2, 2, {0, 150, 255} };
-
-OutlineShader outlineShader{ persp, true, {20, 20, 20} };
-RainbowShader rainbowShader{ persp, true };
-
-Mesh lightMesh3{ generateCube({}, {0.15, 0.15, 0.15}, {255, 255, 255}) };
-Light light3{ lightMesh3, 0.5, {255, 255, 255} };
-
-Camera cam{ {0, 0, -4} };
-
-float dist{ 2 };
+DemoScene scene;
+Presenter presenter;
+// One buffer is recorded while the renderer executes the other one
+CommandBuffer commandBuffers[2]{ { renderer }, { renderer } };
+int recording = 0;
 
 void ofApp::setup(){
 	ofSetWindowShape(width, height);
 
 	renderer.setClearColor({25, 255});
-
-	shader.addLight(light);
-	shader.addLight(light2);
-	shader.addLight(light3);
-
-	outlineShader.addLight(light);
-	outlineShader.addLight(light2);
-	outlineShader.addLight(light3);
-
-	rainbowShader.addLight(light);
-	rainbowShader.addLight(light2);
-	rainbowShader.addLight(light3);
-
-	outlineShader.setUniform1fv("minThickness", 0.2f);
-	outlineShader.setUniform1fv("maxThickness", 0.4f);
-
-	rainbowShader.setUniform1fv("frequency", 300);
+	// Shade every pixel only once, no matter how many triangles overlap it
+	renderer.setDeferred(true);
+	// All of the meshes are closed, their back faces are always hidden
+	renderer.setCullMode(CullMode::Back);
 
 	ofHideCursor();
 }
@@ -67,48 +35,29 @@ void ofApp::setup(){
 void ofApp::update(){
 	updateInput();
 
-	float time = ofGetElapsedTimeMillis() / 1000.0f;
-	float sinTime = sin(time);
-	float cosTime = cos(time);
-
-	shader.setUniform4fm("view", cam.getMatrix());
-
-	outlineShader.setUniform4fm("view", cam.getMatrix());
-	outlineShader.setUniform1fv("sinTime", sinTime);
-	
-	unlit.setUniform4fm("view", cam.getMatrix());
-
-	rainbowShader.setUniform4fm("view", cam.getMatrix());
-	rainbowShader.setUniform1fv("time", time * 50);
-
-	cube.setRotation(glm::vec3{ time, 0, time } * 30.0f);
-	pyramid.setRotation(glm::vec3{ 0, 0, time * 20 });
-
-	const float invSin = sin(-time);
-	const float invCos = cos(-time);
-
-	lightMesh3.setPosition(pyramid.getPosition() + glm::vec3{ 0,	invSin, invCos });
+	scene.update(ofGetElapsedTimeMillis() / 1000.0f);
 }
 
 void ofApp::draw(){
-	renderer.clearBuffers();
-
-	renderer.setShader(&unlit);
-	lightMesh.render(renderer);
-	lightMesh2.render(renderer);
-	lightMesh3.render(renderer);
-
-	// light2.render(renderer);
-	renderer.setShader(&outlineShader);
-	cube.render(renderer);
+	/* Three frames are in flight: this one is recorded, running its vertex stage, while the renderer rasterizes the one
+	 * submitted last into the back target and the one before it is shown from the front target
+	 */
+	CommandBuffer& commands = commandBuffers[recording];
+	commands.reset();
+	scene.record(commands);
 
-	renderer.setShader(&rainbowShader);
-	pyramid.render(renderer);
+	const float limit = min(ofGetWindowWidth(), ofGetWindowHeight());
+	presenter.upload(renderer.getFrontTarget());
+	presenter.draw((ofGetWindowWidth() - limit) / 2, (ofGetWindowHeight() - limit) / 2, limit, limit);
 
 	// Draw fps counter
-	const float limit = min(ofGetWindowWidth(), ofGetWindowHeight());
-	renderer.getTexture().draw((ofGetWindowWidth() - limit) / 2, (ofGetWindowHeight() - limit) / 2, limit, limit);
 	ofDrawBitmapString(to_string(ofGetFrameRate()), 10, 20);
+
+	// The frame submitted last becomes the front one, and the renderer starts drawing this one
+	renderer.wait();
+	renderer.swapTargets();
+	renderer.submit(commands);
+	recording = 1 - recording;
 }
 
 bool firstMove = true;
@@ -123,6 +72,7 @@ void ofApp::mouseMoved(int x, int y)
 	int xDelta{ x - ofGetPreviousMouseX() };
 	int yDelta{ y - ofGetPreviousMouseY() };
 
+	Camera& cam = scene.getCamera();
 	if (xDelta != 0)
 		cam.rotate(CameraAxis::Yaw, -xDelta);
 	if (yDelta != 0)
@@ -153,9 +103,11 @@ void updateInput()
 	for (const auto& kvp : mappings)
 	{
 		if (glfwGetKey(window, kvp.first) == GLFW_PRESS)
-			cam.move(kvp.second);
+			scene.getCamera().move(kvp.second);
 	}
 
+	Mesh& cube = scene.getCube();
+
 	const float amount = 80.0f * ofGetLastFrameTime();
 
 	if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
@@ -171,8 +123,3 @@ void updateInput()
 	if (glfwGetKey(window, GLFW_KEY_KP_3) == GLFW_PRESS)
 		cube.getRotation() -= glm::vec3{0, 1, 0} *amount;
 }
-
-glm::mat4 getPerspective()
-{
-	return glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
-}
\ No newline at end of file